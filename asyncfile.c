@@ -0,0 +1,112 @@
+#ifndef __APPLE__
+#define _GNU_SOURCE     // for fopencookie
+#endif
+#include "asyncfile.h"
+#include "ringbuf.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <time.h>
+
+struct async_file {
+    FILE* out;
+    struct ringbuf ring;
+    pthread_t thread;
+    atomic_int closing;
+    atomic_int failed;      // a write to the file failed
+};
+
+static void nap(void)
+{
+    struct timespec ts = { 0, 100000 };    // 100 us
+    nanosleep(&ts, NULL);
+}
+
+// The writer thread: hand whatever is in the ring to the file in large writes
+static void* writer_thread(void* arg)
+{
+    struct async_file* af = arg;
+    for (;;) {
+        const void* data;
+        size_t len = ringbuf_peek(&af->ring, &data);
+        if (len) {
+            // after a failure keep emptying the ring, so the producer never waits for ever
+            if (fwrite(data, 1, len, af->out) != len)
+                atomic_store(&af->failed, 1);
+            ringbuf_consume(&af->ring, len);
+        } else if (atomic_load(&af->closing)) {
+            // the last data may have been written after the peek, just before closing was set
+            if (ringbuf_used(&af->ring) == 0)
+                break;
+        } else {
+            nap();
+        }
+    }
+    return NULL;
+}
+
+static ssize_t async_write(void* cookie, const char* buf, size_t size)
+{
+    struct async_file* af = cookie;
+    if (atomic_load(&af->failed))
+        return -1;
+    size_t done = 0;
+    while (done < size) {
+        size_t n = ringbuf_write(&af->ring, buf + done, size - done);
+        done += n;
+        if (n == 0)
+            sched_yield();      // ring is full, let the writer catch up
+    }
+    return size;
+}
+
+static int async_close(void* cookie)
+{
+    struct async_file* af = cookie;
+    atomic_store(&af->closing, 1);
+    pthread_join(af->thread, NULL);
+    int status = fclose(af->out);
+    if (atomic_load(&af->failed))
+        status = EOF;
+    ringbuf_free(&af->ring);
+    free(af);
+    return status;
+}
+
+#ifdef __APPLE__
+static int async_write_bsd(void* cookie, const char* buf, int size)
+{
+    return async_write(cookie, buf, size);
+}
+#endif
+
+FILE* async_fopen(const char* file_name, size_t ring_size)
+{
+    FILE* out = fopen(file_name, "w");
+    if (out == NULL)
+        return NULL;
+    struct async_file* af = calloc(1, sizeof(struct async_file));
+    af->out = out;
+    ringbuf_init(&af->ring, ring_size);
+    atomic_init(&af->closing, 0);
+    atomic_init(&af->failed, 0);
+    if (pthread_create(&af->thread, NULL, writer_thread, af)) {
+        ringbuf_free(&af->ring);
+        free(af);
+        return out;     // no thread, fall back to plain writes
+    }
+    setvbuf(out, NULL, _IONBF, 0);     // the writer thread only does large writes
+#ifdef __APPLE__
+    FILE* stream = funopen(af, NULL, async_write_bsd, NULL, async_close);
+#else
+    cookie_io_functions_t funcs = { NULL, async_write, NULL, async_close };
+    FILE* stream = fopencookie(af, "w", funcs);
+#endif
+    if (stream == NULL) {
+        async_close(af);
+        return NULL;
+    }
+    setvbuf(stream, NULL, _IOFBF, 1 << 16);
+    return stream;
+}
@@ -0,0 +1,12 @@
+#ifndef __ASYNCFILE_H__
+#define __ASYNCFILE_H__
+
+#include <stdio.h>
+
+// Open a file for writing where the actual writes are done by a dedicated
+// thread. Data written through the returned stream goes into a lock-free
+// ring buffer, and the caller only waits when the ring is full. fclose
+// drains the ring and stops the thread. Returns NULL on failure.
+FILE* async_fopen(const char* file_name, size_t ring_size);
+
+#endif
@@ -0,0 +1,96 @@
+#include "bbv.h"
+#include "pctable.h"
+#include <stdlib.h>
+
+struct bbv_block {
+    int id;
+    long count;         // instructions in the current interval
+};
+
+struct bbv_writer {
+    FILE* out;
+    long interval;
+    long next_end;      // instruction count where the current interval ends
+    long intervals;
+    int num_blocks;
+    struct pctable* blocks;     // start -> struct bbv_block
+    int* touched;       // ids of the blocks with a count in this interval
+    int num_touched;
+    uint32_t* starts;   // by id - 1
+    int starts_cap;
+};
+
+struct bbv_writer* bbv_create(FILE* out, long interval)
+{
+    struct bbv_writer* bw = calloc(1, sizeof(struct bbv_writer));
+    bw->out = out;
+    bw->interval = interval;
+    bw->next_end = interval;
+    bw->blocks = pctable_create(sizeof(struct bbv_block));
+    return bw;
+}
+
+void bbv_delete(struct bbv_writer* bw)
+{
+    pctable_delete(bw->blocks);
+    free(bw->touched);
+    free(bw->starts);
+    free(bw);
+}
+
+static void write_interval(struct bbv_writer* bw)
+{
+    if (bw->num_touched == 0)
+        return;
+    fputc('T', bw->out);
+    for (int i = 0; i < bw->num_touched; i++) {
+        struct bbv_block* b = pctable_find(bw->blocks, bw->starts[bw->touched[i] - 1]);
+        fprintf(bw->out, ":%d:%ld ", b->id, b->count);
+        b->count = 0;
+    }
+    fputc('\n', bw->out);
+    bw->num_touched = 0;
+    bw->intervals++;
+}
+
+static void count_block(struct bbv_writer* bw, uint32_t start, uint32_t end)
+{
+    struct bbv_block* b = pctable_get(bw->blocks, start);
+    if (b->id == 0) {
+        if (bw->num_blocks == bw->starts_cap) {
+            bw->starts_cap = bw->starts_cap ? bw->starts_cap * 2 : 1024;
+            bw->starts = realloc(bw->starts, bw->starts_cap * sizeof(uint32_t));
+            bw->touched = realloc(bw->touched, bw->starts_cap * sizeof(int));
+        }
+        b->id = ++bw->num_blocks;
+        bw->starts[b->id - 1] = start;
+    }
+    if (b->count == 0)
+        bw->touched[bw->num_touched++] = b->id;
+    b->count += (end - start) / 4 + 1;
+}
+
+void bbv_block(struct bbv_writer* bw, uint32_t start, uint32_t end, long insns)
+{
+    count_block(bw, start, end);
+    if (insns >= bw->next_end) {
+        write_interval(bw);
+        bw->next_end += bw->interval;
+    }
+}
+
+void bbv_finish(struct bbv_writer* bw, uint32_t start, uint32_t end)
+{
+    count_block(bw, start, end);
+    write_interval(bw);
+}
+
+void bbv_flush(struct bbv_writer* bw)
+{
+    write_interval(bw);
+}
+
+long bbv_intervals(struct bbv_writer* bw)
+{
+    return bw->intervals;
+}
@@ -0,0 +1,32 @@
+#ifndef __BBV_H__
+#define __BBV_H__
+
+#include <stdint.h>
+#include <stdio.h>
+
+// Basic block vectors for SimPoint: for every interval of a fixed number of
+// instructions, how many instructions were executed in each basic block.
+// Written in the SimPoint .bb format, one line per interval:
+//   T:id:count :id:count ...
+// where blocks are numbered from 1 in the order they were first executed.
+// A block is counted in the interval in which it ends.
+struct bbv_writer;
+
+struct bbv_writer* bbv_create(FILE* out, long interval);
+
+// the block from start to end (the branch or jump) ran; insns is the
+// instruction count after it
+void bbv_block(struct bbv_writer* bw, uint32_t start, uint32_t end, long insns);
+
+// record the final block and write the last, partial, interval
+void bbv_finish(struct bbv_writer* bw, uint32_t start, uint32_t end);
+
+// write the last, partial, interval when the run stopped at a block boundary
+void bbv_flush(struct bbv_writer* bw);
+
+// the number of intervals written
+long bbv_intervals(struct bbv_writer* bw);
+
+void bbv_delete(struct bbv_writer* bw);
+
+#endif
@@ -0,0 +1,54 @@
+#include "blocks.h"
+#include "pctable.h"
+#include <stdlib.h>
+
+struct block {
+    long count;
+    uint32_t end;
+};
+
+struct block_counts {
+    struct pctable* blocks;     // start -> struct block
+    uint32_t tail_start;
+    uint32_t tail_end;
+    int has_tail;
+};
+
+struct block_counts* block_counts_create(void)
+{
+    struct block_counts* bc = calloc(1, sizeof(struct block_counts));
+    bc->blocks = pctable_create(sizeof(struct block));
+    return bc;
+}
+
+void block_counts_delete(struct block_counts* bc)
+{
+    pctable_delete(bc->blocks);
+    free(bc);
+}
+
+void block_counts_record(struct block_counts* bc, uint32_t start, uint32_t end)
+{
+    struct block* b = pctable_get(bc->blocks, start);
+    b->count++;
+    b->end = end;
+}
+
+void block_counts_finish(struct block_counts* bc, uint32_t start, uint32_t end)
+{
+    bc->tail_start = start;
+    bc->tail_end = end;
+    bc->has_tail = 1;
+}
+
+void block_counts_foreach(struct block_counts* bc,
+                          void (*fn)(void* ctx, uint32_t start, uint32_t end, long count), void* ctx)
+{
+    int pos = 0;
+    uint32_t start;
+    struct block* b;
+    while ((b = pctable_next(bc->blocks, &pos, &start)))
+        fn(ctx, start, b->end, b->count);
+    if (bc->has_tail)
+        fn(ctx, bc->tail_start, bc->tail_end, 1);
+}
@@ -0,0 +1,22 @@
+#ifndef __BLOCKS_H__
+#define __BLOCKS_H__
+
+#include <stdint.h>
+
+// Execution counts of basic blocks. A block runs from its start address up
+// to and including the branch or jump at its end address.
+struct block_counts;
+
+struct block_counts* block_counts_create(void);
+void block_counts_delete(struct block_counts* bc);
+
+void block_counts_record(struct block_counts* bc, uint32_t start, uint32_t end);
+
+// the final block, cut short when the program terminated
+void block_counts_finish(struct block_counts* bc, uint32_t start, uint32_t end);
+
+// call fn for every block, including the final one
+void block_counts_foreach(struct block_counts* bc,
+                          void (*fn)(void* ctx, uint32_t start, uint32_t end, long count), void* ctx);
+
+#endif
@@ -0,0 +1,436 @@
+#include "bpred.h"
+#include "pctable.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_MODELS 6
+
+#define TAGE_TABLES 4
+#define TAGE_BASE_BITS 12
+#define TAGE_TAG_BITS 9
+#define TAGE_HIST_BUF 256        // power of two, longer than the longest history
+#define TAGE_RESET_PERIOD (1 << 18)  // branches between halving the useful bits
+
+static const int tage_hist_len[TAGE_TABLES] = { 5, 15, 44, 130 };
+
+enum model_kind {
+    MODEL_BTFN,
+    MODEL_BIMODAL,
+    MODEL_GSHARE,
+    MODEL_TAGE,
+};
+
+struct tage_entry {
+    uint16_t tag;
+    int8_t ctr;         // -4..3, taken if >= 0
+    uint8_t u;          // useful, 0..3
+};
+
+// A history of length bits folded into width bits by xor, kept up to date
+// one bit at a time as in Seznec's TAGE.
+struct folded {
+    uint32_t value;
+    int length;
+    int width;
+};
+
+struct tage {
+    int bits;
+    uint8_t base[1 << TAGE_BASE_BITS];
+    struct tage_entry* tables[TAGE_TABLES];
+    uint8_t hist[TAGE_HIST_BUF];    // outcomes, hist[hist_pos] the newest
+    int hist_pos;
+    struct folded index_fold[TAGE_TABLES];
+    struct folded tag_fold[TAGE_TABLES][2];
+    long branches;
+};
+
+struct model {
+    enum model_kind kind;
+    int bits;
+    uint8_t* counters;      // two bit counters, taken if >= 2
+    uint32_t history;       // gshare global history
+    struct tage* tage;
+    long mispredicts;
+    char name[16];
+};
+
+struct site {
+    long executed;
+    int backward;
+    int is_return;
+    long ras_misses;
+    long mispredicts[MAX_MODELS];
+};
+
+struct bpred {
+    int num_models;
+    struct model models[MAX_MODELS];
+    long branches;
+    uint32_t* ras;          // circular, the oldest entries are overwritten
+    int ras_size;
+    int ras_top;
+    int ras_depth;
+    long returns;
+    long ras_misses;
+    struct pctable* sites;  // pc -> struct site
+};
+
+static inline void counter_update(uint8_t* c, int taken)
+{
+    if (taken) {
+        if (*c < 3) (*c)++;
+    } else {
+        if (*c > 0) (*c)--;
+    }
+}
+
+static struct tage* tage_create(int bits)
+{
+    struct tage* t = calloc(1, sizeof(struct tage));
+    t->bits = bits;
+    memset(t->base, 1, sizeof(t->base));
+    for (int i = 0; i < TAGE_TABLES; i++) {
+        t->tables[i] = calloc(1 << bits, sizeof(struct tage_entry));
+        t->index_fold[i] = (struct folded){ 0, tage_hist_len[i], bits };
+        t->tag_fold[i][0] = (struct folded){ 0, tage_hist_len[i], TAGE_TAG_BITS };
+        t->tag_fold[i][1] = (struct folded){ 0, tage_hist_len[i], TAGE_TAG_BITS - 1 };
+    }
+    return t;
+}
+
+static void tage_delete(struct tage* t)
+{
+    for (int i = 0; i < TAGE_TABLES; i++)
+        free(t->tables[i]);
+    free(t);
+}
+
+static inline void fold_update(struct folded* f, const struct tage* t)
+{
+    int newest = t->hist[t->hist_pos];
+    int oldest = t->hist[(t->hist_pos - f->length) & (TAGE_HIST_BUF - 1)];
+    f->value = (f->value << 1) | newest;
+    f->value ^= oldest << (f->length % f->width);
+    f->value ^= f->value >> f->width;
+    f->value &= (1u << f->width) - 1;
+}
+
+// predict the branch and train on its outcome, returns the prediction
+static int tage_branch(struct tage* t, uint32_t pc, int taken)
+{
+    uint32_t mask = (1u << t->bits) - 1;
+    uint32_t index[TAGE_TABLES];
+    uint16_t tag[TAGE_TABLES];
+    int provider = -1, alt = -1;
+    for (int i = TAGE_TABLES - 1; i >= 0; i--) {
+        index[i] = ((pc >> 2) ^ (pc >> (2 + t->bits)) ^ t->index_fold[i].value) & mask;
+        tag[i] = ((pc >> 2) ^ t->tag_fold[i][0].value ^ (t->tag_fold[i][1].value << 1)) &
+                 ((1u << TAGE_TAG_BITS) - 1);
+        if (t->tables[i][index[i]].tag == tag[i]) {
+            if (provider < 0)
+                provider = i;
+            else if (alt < 0)
+                alt = i;
+        }
+    }
+    uint8_t* base = &t->base[(pc >> 2) & ((1 << TAGE_BASE_BITS) - 1)];
+    int base_pred = *base >= 2;
+    int alt_pred = alt >= 0 ? t->tables[alt][index[alt]].ctr >= 0 : base_pred;
+    int pred = base_pred;
+
+    if (provider >= 0) {
+        struct tage_entry* e = &t->tables[provider][index[provider]];
+        pred = e->ctr >= 0;
+        if (taken && e->ctr < 3)
+            e->ctr++;
+        else if (!taken && e->ctr > -4)
+            e->ctr--;
+        if (pred != alt_pred) {
+            if (pred == taken && e->u < 3)
+                e->u++;
+            else if (pred != taken && e->u > 0)
+                e->u--;
+        }
+    } else {
+        counter_update(base, taken);
+    }
+    // on a misprediction take an entry in a table with longer history
+    if (pred != taken && provider < TAGE_TABLES - 1) {
+        int allocated = 0;
+        for (int i = provider + 1; i < TAGE_TABLES && !allocated; i++) {
+            struct tage_entry* e = &t->tables[i][index[i]];
+            if (e->u == 0) {
+                e->tag = tag[i];
+                e->ctr = taken ? 0 : -1;
+                allocated = 1;
+            }
+        }
+        if (!allocated)
+            for (int i = provider + 1; i < TAGE_TABLES; i++)
+                if (t->tables[i][index[i]].u > 0)
+                    t->tables[i][index[i]].u--;
+    }
+    if (++t->branches % TAGE_RESET_PERIOD == 0)
+        for (int i = 0; i < TAGE_TABLES; i++)
+            for (uint32_t j = 0; j <= mask; j++)
+                t->tables[i][j].u >>= 1;
+
+    t->hist_pos = (t->hist_pos + 1) & (TAGE_HIST_BUF - 1);
+    t->hist[t->hist_pos] = taken;
+    for (int i = 0; i < TAGE_TABLES; i++) {
+        fold_update(&t->index_fold[i], t);
+        fold_update(&t->tag_fold[i][0], t);
+        fold_update(&t->tag_fold[i][1], t);
+    }
+    return pred;
+}
+
+static int parse_model(const char* s, int len, int* bits, const char* name, int min, int max, int def)
+{
+    int name_len = strlen(name);
+    if (len < name_len || strncmp(s, name, name_len))
+        return 0;
+    if (len == name_len) {
+        *bits = def;
+        return 1;
+    }
+    if (s[name_len] != ':')
+        return 0;
+    char* end;
+    long v = strtol(s + name_len + 1, &end, 10);
+    if (end != s + len || v < min || v > max)
+        return 0;
+    *bits = v;
+    return 1;
+}
+
+struct bpred* bpred_create(const char* spec)
+{
+    struct bpred* bp = calloc(1, sizeof(struct bpred));
+    bp->ras_size = 16;
+    const char* s = spec;
+    while (1) {
+        int len = strcspn(s, ",");
+        struct model* m = &bp->models[bp->num_models];
+        int bits;
+        if (parse_model(s, len, &bits, "ras", 0, 1024, 16)) {
+            bp->ras_size = bits;
+        } else if (bp->num_models < MAX_MODELS && parse_model(s, len, &bits, "btfn", 0, 0, 0)) {
+            m->kind = MODEL_BTFN;
+            snprintf(m->name, sizeof(m->name), "btfn");
+            bp->num_models++;
+        } else if (bp->num_models < MAX_MODELS && parse_model(s, len, &bits, "bimodal", 1, 24, 12)) {
+            m->kind = MODEL_BIMODAL;
+            m->bits = bits;
+            m->counters = malloc(1 << bits);
+            memset(m->counters, 1, 1 << bits);
+            snprintf(m->name, sizeof(m->name), "bimodal:%d", bits);
+            bp->num_models++;
+        } else if (bp->num_models < MAX_MODELS && parse_model(s, len, &bits, "gshare", 1, 24, 14)) {
+            m->kind = MODEL_GSHARE;
+            m->bits = bits;
+            m->counters = malloc(1 << bits);
+            memset(m->counters, 1, 1 << bits);
+            snprintf(m->name, sizeof(m->name), "gshare:%d", bits);
+            bp->num_models++;
+        } else if (bp->num_models < MAX_MODELS && parse_model(s, len, &bits, "tage", 4, 16, 10)) {
+            m->kind = MODEL_TAGE;
+            m->bits = bits;
+            m->tage = tage_create(bits);
+            snprintf(m->name, sizeof(m->name), "tage:%d", bits);
+            bp->num_models++;
+        } else {
+            bpred_delete(bp);
+            return NULL;
+        }
+        if (s[len] == '\0')
+            break;
+        s += len + 1;
+    }
+    bp->ras = calloc(bp->ras_size + 1, sizeof(uint32_t));
+    bp->sites = pctable_create(sizeof(struct site));
+    return bp;
+}
+
+void bpred_delete(struct bpred* bp)
+{
+    for (int i = 0; i < bp->num_models; i++) {
+        free(bp->models[i].counters);
+        if (bp->models[i].tage)
+            tage_delete(bp->models[i].tage);
+    }
+    if (bp->sites)
+        pctable_delete(bp->sites);
+    free(bp->ras);
+    free(bp);
+}
+
+int bpred_branch(struct bpred* bp, uint32_t pc, uint32_t target, int taken)
+{
+    struct site* site = pctable_get(bp->sites, pc);
+    site->executed++;
+    site->backward = target < pc;
+    bp->branches++;
+    int first_miss = 0;
+    for (int i = 0; i < bp->num_models; i++) {
+        struct model* m = &bp->models[i];
+        int pred;
+        switch (m->kind) {
+            case MODEL_BTFN:
+                pred = target < pc;
+                break;
+            case MODEL_BIMODAL: {
+                uint8_t* c = &m->counters[(pc >> 2) & ((1u << m->bits) - 1)];
+                pred = *c >= 2;
+                counter_update(c, taken);
+                break;
+            }
+            case MODEL_GSHARE: {
+                uint32_t mask = (1u << m->bits) - 1;
+                uint8_t* c = &m->counters[((pc >> 2) ^ m->history) & mask];
+                pred = *c >= 2;
+                counter_update(c, taken);
+                m->history = ((m->history << 1) | taken) & mask;
+                break;
+            }
+            default:
+                pred = tage_branch(m->tage, pc, taken);
+                break;
+        }
+        if (pred != taken) {
+            m->mispredicts++;
+            site->mispredicts[i]++;
+            if (i == 0)
+                first_miss = 1;
+        }
+    }
+    return first_miss;
+}
+
+void bpred_call(struct bpred* bp, uint32_t ret)
+{
+    if (bp->ras_size == 0)
+        return;
+    bp->ras[bp->ras_top] = ret;
+    bp->ras_top = (bp->ras_top + 1) % bp->ras_size;
+    if (bp->ras_depth < bp->ras_size)
+        bp->ras_depth++;
+}
+
+int bpred_return(struct bpred* bp, uint32_t pc, uint32_t target)
+{
+    struct site* site = pctable_get(bp->sites, pc);
+    site->executed++;
+    site->is_return = 1;
+    bp->returns++;
+    int miss = 1;
+    if (bp->ras_depth > 0) {
+        bp->ras_top = (bp->ras_top + bp->ras_size - 1) % bp->ras_size;
+        bp->ras_depth--;
+        miss = bp->ras[bp->ras_top] != target;
+    }
+    if (miss) {
+        bp->ras_misses++;
+        site->ras_misses++;
+    }
+    return miss;
+}
+
+void bpred_get_stats(struct bpred* bp, struct bpred_stats* stats)
+{
+    stats->has_direction = bp->num_models > 0;
+    stats->has_ras = bp->ras_size > 0;
+    stats->branches = bp->branches;
+    stats->mispredicts = bp->num_models ? bp->models[0].mispredicts : 0;
+    stats->returns = bp->returns;
+    stats->ras_misses = bp->ras_misses;
+}
+
+struct site_line {
+    uint32_t pc;
+    struct site site;
+    long key;           // mispredictions by the first model, or by the return address stack
+};
+
+static int compare_key(const void* a, const void* b)
+{
+    const struct site_line* la = a;
+    const struct site_line* lb = b;
+    if (la->key != lb->key)
+        return la->key > lb->key ? -1 : 1;
+    return la->pc < lb->pc ? -1 : la->pc > lb->pc;
+}
+
+static double percent(long part, long total)
+{
+    return total ? 100.0 * part / total : 0.0;
+}
+
+void bpred_write_report(struct bpred* bp, struct symbols* symbols, long num_insns, FILE* out, int num_sites)
+{
+    int n = pctable_count(bp->sites);
+    struct site_line* lines = malloc((n + 1) * sizeof(struct site_line));
+    int branch_sites = 0;
+    int pos = 0;
+    for (int i = 0; i < n; i++) {
+        struct site_line* line = &lines[i];
+        line->site = *(struct site*)pctable_next(bp->sites, &pos, &line->pc);
+        if (line->site.is_return) {
+            line->key = line->site.ras_misses;
+        } else {
+            line->key = bp->num_models ? line->site.mispredicts[0] : 0;
+            branch_sites++;
+        }
+    }
+    qsort(lines, n, sizeof(struct site_line), compare_key);
+
+    fprintf(out, "Branch prediction: %ld conditional branches at %d sites, %ld returns\n",
+            bp->branches, branch_sites, bp->returns);
+    fprintf(out, "  %-12s %12s %8s %8s\n", "model", "mispredicts", "rate", "MPKI");
+    for (int i = 0; i < bp->num_models; i++) {
+        struct model* m = &bp->models[i];
+        fprintf(out, "  %-12s %12ld %7.2f%% %8.3f\n", m->name, m->mispredicts,
+                percent(m->mispredicts, bp->branches), num_insns ? 1000.0 * m->mispredicts / num_insns : 0.0);
+    }
+    if (bp->ras_size) {
+        char name[16];
+        snprintf(name, sizeof(name), "ras:%d", bp->ras_size);
+        fprintf(out, "  %-12s %12ld %7.2f%% %8.3f   (returns)\n", name, bp->ras_misses,
+                percent(bp->ras_misses, bp->returns), num_insns ? 1000.0 * bp->ras_misses / num_insns : 0.0);
+    }
+
+    if (num_sites > n)
+        num_sites = n;
+    fprintf(out, "\nSites with most mispredictions:\n");
+    fprintf(out, "%8s  %-4s %12s", "address", "dir", "executed");
+    for (int i = 0; i < bp->num_models; i++)
+        fprintf(out, " %12s", bp->models[i].name);
+    if (bp->ras_size)
+        fprintf(out, " %12s", "ras");
+    fprintf(out, "  location\n");
+    for (int i = 0; i < num_sites && lines[i].key; i++) {
+        struct site_line* line = &lines[i];
+        const char* dir = line->site.is_return ? "ret" : line->site.backward ? "bwd" : "fwd";
+        fprintf(out, "%08x  %-4s %12ld", line->pc, dir, line->site.executed);
+        for (int m = 0; m < bp->num_models; m++) {
+            if (line->site.is_return)
+                fprintf(out, " %12s", "-");
+            else
+                fprintf(out, " %12ld", line->site.mispredicts[m]);
+        }
+        if (bp->ras_size) {
+            if (line->site.is_return)
+                fprintf(out, " %12ld", line->site.ras_misses);
+            else
+                fprintf(out, " %12s", "-");
+        }
+        unsigned int func;
+        const char* name = symbols ? symbols_addr_to_func(symbols, line->pc, &func) : NULL;
+        if (name)
+            fprintf(out, "  %s+0x%x\n", name, line->pc - func);
+        else
+            fprintf(out, "  ?\n");
+    }
+    free(lines);
+}
@@ -0,0 +1,45 @@
+#ifndef __BPRED_H__
+#define __BPRED_H__
+
+#include "read_elf.h"
+#include <stdint.h>
+#include <stdio.h>
+
+// Branch predictor models, run side by side on the same branches:
+//   btfn          static, backward taken and forward not taken
+//   bimodal[:n]   2^n two bit counters indexed by pc (default 12)
+//   gshare[:n]    2^n two bit counters indexed by pc xor n bits of global history (default 14)
+//   tage[:n]      a bimodal base and four tagged tables of 2^n entries with
+//                 5, 15, 44 and 130 branches of global history (default 10)
+//   ras[:n]       return address stack of n entries for returns (default 16, 0 for none)
+// The first direction model is the one whose mispredictions are returned.
+struct bpred;
+
+// parse a comma separated list like "gshare:14,tage,ras:8", NULL if not valid
+struct bpred* bpred_create(const char* spec);
+void bpred_delete(struct bpred* bp);
+
+// a conditional branch at pc; returns 1 if the first model mispredicted it
+int bpred_branch(struct bpred* bp, uint32_t pc, uint32_t target, int taken);
+
+// a call which returns to ret
+void bpred_call(struct bpred* bp, uint32_t ret);
+
+// a return at pc to target; returns 1 if the return address stack mispredicted it
+int bpred_return(struct bpred* bp, uint32_t pc, uint32_t target);
+
+struct bpred_stats {
+    int has_direction;      // there is a model for branch directions
+    int has_ras;            // there is a return address stack
+    long branches;
+    long mispredicts;       // by the first model
+    long returns;
+    long ras_misses;
+};
+
+void bpred_get_stats(struct bpred* bp, struct bpred_stats* stats);
+
+// report misprediction rates per model and the sites with most mispredictions
+void bpred_write_report(struct bpred* bp, struct symbols* symbols, long num_insns, FILE* out, int num_sites);
+
+#endif
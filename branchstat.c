@@ -0,0 +1,117 @@
+#include "branchstat.h"
+#include "pctable.h"
+#include <stdlib.h>
+
+struct branch_site {
+    long taken;
+    long not_taken;
+    long changes;           // times the outcome differed from the previous one
+    int backward;
+    int last_taken;
+};
+
+struct branch_stats {
+    struct pctable* sites;  // pc -> struct branch_site
+};
+
+struct branch_stats* branch_stats_create(void)
+{
+    struct branch_stats* bs = malloc(sizeof(struct branch_stats));
+    bs->sites = pctable_create(sizeof(struct branch_site));
+    return bs;
+}
+
+void branch_stats_delete(struct branch_stats* bs)
+{
+    pctable_delete(bs->sites);
+    free(bs);
+}
+
+void branch_stats_record(struct branch_stats* bs, uint32_t pc, int backward, int taken)
+{
+    struct branch_site* site = pctable_get(bs->sites, pc);
+    if (site->taken + site->not_taken == 0) {
+        site->backward = backward;
+    } else if (site->last_taken != taken) {
+        site->changes++;
+    }
+    site->last_taken = taken;
+    if (taken)
+        site->taken++;
+    else
+        site->not_taken++;
+}
+
+struct site_line {
+    uint32_t pc;
+    struct branch_site site;
+    double score;
+    double mispredicts;
+};
+
+// A branch is hard to predict if it is neither strongly biased nor repeats
+// its last outcome: the score is the lower of the minority outcome rate and
+// the outcome change rate, i.e. the miss rate of the better of a perfect
+// static predictor and a last-outcome predictor. It lies between 0 and 0.5.
+static double unpredictability(struct branch_site* site)
+{
+    long total = site->taken + site->not_taken;
+    long minority = site->taken < site->not_taken ? site->taken : site->not_taken;
+    long misses = minority < site->changes ? minority : site->changes;
+    return total ? (double)misses / total : 0.0;
+}
+
+static int compare_mispredicts(const void* a, const void* b)
+{
+    const struct site_line* la = a;
+    const struct site_line* lb = b;
+    if (la->mispredicts != lb->mispredicts)
+        return la->mispredicts > lb->mispredicts ? -1 : 1;
+    return la->pc < lb->pc ? -1 : la->pc > lb->pc;
+}
+
+void branch_stats_write(struct branch_stats* bs, struct symbols* symbols, FILE* out, int num_sites)
+{
+    int n = pctable_count(bs->sites);
+    struct site_line* lines = malloc((n + 1) * sizeof(struct site_line));
+    long fwd = 0, fwd_taken = 0, bwd = 0, bwd_taken = 0;
+    int pos = 0;
+    for (int i = 0; i < n; i++) {
+        struct site_line* line = &lines[i];
+        line->site = *(struct branch_site*)pctable_next(bs->sites, &pos, &line->pc);
+        long total = line->site.taken + line->site.not_taken;
+        line->score = unpredictability(&line->site);
+        line->mispredicts = line->score * total;
+        if (line->site.backward) {
+            bwd += total;
+            bwd_taken += line->site.taken;
+        } else {
+            fwd += total;
+            fwd_taken += line->site.taken;
+        }
+    }
+    qsort(lines, n, sizeof(struct site_line), compare_mispredicts);
+
+    fprintf(out, "Conditional branches: %d sites\n", n);
+    fprintf(out, "  forward:  %12ld executed, %12ld taken (%.2f%%)\n",
+            fwd, fwd_taken, fwd ? 100.0 * fwd_taken / fwd : 0.0);
+    fprintf(out, "  backward: %12ld executed, %12ld taken (%.2f%%)\n",
+            bwd, bwd_taken, bwd ? 100.0 * bwd_taken / bwd : 0.0);
+    if (num_sites > n)
+        num_sites = n;
+    fprintf(out, "\nHardest to predict branches (ranked by score * executions):\n");
+    fprintf(out, "%8s  %-4s %12s %12s %12s %6s  %s\n",
+            "address", "dir", "taken", "not taken", "changes", "score", "location");
+    for (int i = 0; i < num_sites; i++) {
+        struct site_line* line = &lines[i];
+        fprintf(out, "%08x  %-4s %12ld %12ld %12ld %6.3f  ", line->pc, line->site.backward ? "bwd" : "fwd",
+                line->site.taken, line->site.not_taken, line->site.changes, line->score);
+        unsigned int func;
+        const char* name = symbols ? symbols_addr_to_func(symbols, line->pc, &func) : NULL;
+        if (name)
+            fprintf(out, "%s+0x%x\n", name, line->pc - func);
+        else
+            fprintf(out, "?\n");
+    }
+    free(lines);
+}
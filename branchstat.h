@@ -0,0 +1,20 @@
+#ifndef __BRANCHSTAT_H__
+#define __BRANCHSTAT_H__
+
+#include "read_elf.h"
+#include <stdint.h>
+#include <stdio.h>
+
+// Per branch site statistics for conditional branches
+struct branch_stats;
+
+struct branch_stats* branch_stats_create(void);
+void branch_stats_delete(struct branch_stats* bs);
+
+// record one execution of the conditional branch at pc
+void branch_stats_record(struct branch_stats* bs, uint32_t pc, int backward, int taken);
+
+// report totals and the hardest to predict branch sites
+void branch_stats_write(struct branch_stats* bs, struct symbols* symbols, FILE* out, int num_sites);
+
+#endif
@@ -0,0 +1,305 @@
+#include "btrace.h"
+#include "helper.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define RAS_SIZE 32
+#define WRITE_BUFFER_SIZE (1 << 16)
+
+// Return address stack, identical on both ends
+struct ras {
+    uint32_t entries[RAS_SIZE];
+    int top;
+    int count;
+};
+
+static void ras_push(struct ras* ras, uint32_t addr)
+{
+    ras->top = (ras->top + 1) % RAS_SIZE;
+    ras->entries[ras->top] = addr;
+    if (ras->count < RAS_SIZE)
+        ras->count++;
+}
+
+// pop if addr is on top of the stack
+static int ras_match(struct ras* ras, uint32_t addr)
+{
+    if (ras->count == 0 || ras->entries[ras->top] != addr)
+        return 0;
+    ras->top = (ras->top + RAS_SIZE - 1) % RAS_SIZE;
+    ras->count--;
+    return 1;
+}
+
+struct btrace_writer {
+    FILE* out;
+    struct ras ras;
+    unsigned int bits;      // pending outcomes
+    int num_bits;
+    size_t used;
+    unsigned char buffer[WRITE_BUFFER_SIZE];
+};
+
+static void flush(struct btrace_writer* bt)
+{
+    fwrite(bt->buffer, 1, bt->used, bt->out);
+    bt->used = 0;
+}
+
+static inline void put_byte(struct btrace_writer* bt, unsigned char b)
+{
+    if (bt->used == WRITE_BUFFER_SIZE)
+        flush(bt);
+    bt->buffer[bt->used++] = b;
+}
+
+static void put_varint(struct btrace_writer* bt, uint32_t v)
+{
+    while (v >= 0x80) {
+        put_byte(bt, (v & 0x7f) | 0x80);
+        v >>= 7;
+    }
+    put_byte(bt, v);
+}
+
+static void flush_bits(struct btrace_writer* bt)
+{
+    if (bt->num_bits) {
+        put_byte(bt, (1 << bt->num_bits) | bt->bits);
+        bt->bits = 0;
+        bt->num_bits = 0;
+    }
+}
+
+static inline void put_bit(struct btrace_writer* bt, int bit)
+{
+    bt->bits |= (bit ? 1 : 0) << bt->num_bits;
+    if (++bt->num_bits == 6)
+        flush_bits(bt);
+}
+
+struct btrace_writer* btrace_writer_create(FILE* out, uint32_t start_pc)
+{
+    struct btrace_writer* bt = calloc(1, sizeof(struct btrace_writer));
+    bt->out = out;
+    fwrite("RVB1", 1, 4, out);
+    unsigned char pc[4] = { start_pc, start_pc >> 8, start_pc >> 16, start_pc >> 24 };
+    fwrite(pc, 1, 4, out);
+    return bt;
+}
+
+void btrace_branch(struct btrace_writer* bt, int taken)
+{
+    put_bit(bt, taken);
+}
+
+void btrace_jal(struct btrace_writer* bt, uint32_t pc, int rd)
+{
+    if (rd == 1)
+        ras_push(&bt->ras, pc + 4);
+}
+
+void btrace_jalr(struct btrace_writer* bt, uint32_t pc, int rd, uint32_t target)
+{
+    if (ras_match(&bt->ras, target)) {
+        put_bit(bt, 1);
+    } else {
+        put_bit(bt, 0);
+        flush_bits(bt);
+        put_byte(bt, BTRACE_TARGET);
+        int32_t offset = target - pc;
+        put_varint(bt, ((uint32_t)offset << 1) ^ (uint32_t)(offset >> 31));
+    }
+    if (rd == 1)
+        ras_push(&bt->ras, pc + 4);
+}
+
+void btrace_end(struct btrace_writer* bt, long num_insns, int reason)
+{
+    flush_bits(bt);
+    put_byte(bt, BTRACE_END);
+    // instruction counts may exceed 32 bits
+    unsigned long n = num_insns;
+    while (n >= 0x80) {
+        put_byte(bt, (n & 0x7f) | 0x80);
+        n >>= 7;
+    }
+    put_byte(bt, n);
+    put_byte(bt, reason);
+}
+
+void btrace_writer_close(struct btrace_writer* bt)
+{
+    flush(bt);
+    fflush(bt->out);
+    free(bt);
+}
+
+struct btrace_reader {
+    FILE* in;
+    struct memory* mem;
+    struct ras ras;
+    uint32_t pc;
+    unsigned int bits;
+    int num_bits;
+    long count;
+    long total;             // from the end packet, -1 until it has been read
+    int reason;
+    int done;
+};
+
+static unsigned long get_varint(struct btrace_reader* br)
+{
+    unsigned long v = 0;
+    int shift = 0, b;
+    do {
+        b = getc(br->in);
+        if (b == EOF)
+            break;
+        if (shift < 64)
+            v |= (unsigned long)(b & 0x7f) << shift;
+        shift += 7;
+    } while (b & 0x80);
+    return v;
+}
+
+// Read packets until outcome bits are available or the end is seen.
+// Returns 0 if there are no more bits.
+static int fill_bits(struct btrace_reader* br)
+{
+    while (br->num_bits == 0 && br->total < 0) {
+        int b = getc(br->in);
+        if (b == EOF) {
+            br->total = br->count;      // cut short
+            br->reason = -1;
+            return 0;
+        }
+        if (b == BTRACE_END) {
+            br->total = get_varint(br);
+            br->reason = getc(br->in);
+            return 0;
+        }
+        if (b & 0x80) {
+            br->total = br->count;      // a target packet out of place: corrupt trace
+            br->reason = -1;
+            return 0;
+        }
+        int n = 6;
+        while (n > 0 && !(b & (1 << n)))
+            n--;
+        br->bits = b & ((1 << n) - 1);
+        br->num_bits = n;
+    }
+    return br->num_bits > 0;
+}
+
+// At an ecall the program may exit, which is only known from the end packet
+static void check_end(struct btrace_reader* br)
+{
+    if (br->num_bits || br->total >= 0)
+        return;
+    int b = getc(br->in);
+    if (b == BTRACE_END) {
+        br->total = get_varint(br);
+        br->reason = getc(br->in);
+    } else if (b == EOF) {
+        br->total = br->count + 1;
+        br->reason = -1;
+    } else {
+        ungetc(b, br->in);
+    }
+}
+
+static int get_bit(struct btrace_reader* br)
+{
+    if (!fill_bits(br))
+        return -1;
+    int bit = br->bits & 1;
+    br->bits >>= 1;
+    br->num_bits--;
+    return bit;
+}
+
+struct btrace_reader* btrace_reader_open(FILE* in, struct memory* mem)
+{
+    unsigned char header[8];
+    if (fread(header, 1, 8, in) != 8 || memcmp(header, "RVB1", 4) != 0)
+        return NULL;
+    struct btrace_reader* br = calloc(1, sizeof(struct btrace_reader));
+    br->in = in;
+    br->mem = mem;
+    br->pc = header[4] | header[5] << 8 | header[6] << 16 | (uint32_t)header[7] << 24;
+    br->total = -1;
+    return br;
+}
+
+int btrace_next(struct btrace_reader* br, uint32_t* pc, uint32_t* insn)
+{
+    if (br->done || (br->total >= 0 && br->count >= br->total)) {
+        br->done = 1;
+        return 0;
+    }
+    uint32_t cur = br->pc;
+    uint32_t word = memory_rd_w(br->mem, cur);
+    uint32_t next = cur + 4;
+    int rd = get_bits(word, 7, 5);
+    switch (word & 0x7f) {
+        case 0x63: {        // branch
+            int taken = get_bit(br);
+            if (taken < 0) {
+                br->done = 1;
+                return 0;
+            }
+            if (taken)
+                next = cur + sign_extend((get_bits(word, 31, 1) << 12) | (get_bits(word, 7, 1) << 11) |
+                                         (get_bits(word, 25, 6) << 5) | (get_bits(word, 8, 4) << 1), 13);
+            break;
+        }
+        case 0x6f:          // jal
+            next = cur + sign_extend((get_bits(word, 31, 1) << 20) | (get_bits(word, 12, 8) << 12) |
+                                     (get_bits(word, 20, 1) << 11) | (get_bits(word, 21, 10) << 1), 21);
+            if (rd == 1)
+                ras_push(&br->ras, cur + 4);
+            break;
+        case 0x67: {        // jalr
+            int predicted = get_bit(br);
+            if (predicted < 0) {
+                br->done = 1;
+                return 0;
+            }
+            if (predicted) {
+                next = br->ras.entries[br->ras.top];
+                ras_match(&br->ras, next);
+            } else {
+                if (getc(br->in) != BTRACE_TARGET) {
+                    br->done = 1;
+                    br->reason = -1;
+                    return 0;
+                }
+                uint32_t zz = get_varint(br);
+                next = cur + ((int32_t)(zz >> 1) ^ -(int32_t)(zz & 1));
+            }
+            if (rd == 1)
+                ras_push(&br->ras, cur + 4);
+            break;
+        }
+        case 0x73:          // ecall
+            check_end(br);
+            break;
+    }
+    *pc = cur;
+    *insn = word;
+    br->pc = next;
+    br->count++;
+    return 1;
+}
+
+int btrace_end_reason(struct btrace_reader* br)
+{
+    return br->reason;
+}
+
+void btrace_reader_close(struct btrace_reader* br)
+{
+    free(br);
+}
@@ -0,0 +1,54 @@
+#ifndef __BTRACE_H__
+#define __BTRACE_H__
+
+#include "memory.h"
+#include <stdint.h>
+#include <stdio.h>
+
+// Branch trace in the style of hardware processor trace. Only control flow
+// which cannot be found from the code is recorded: one taken/not-taken bit
+// per conditional branch, and the target of jalr. Both writer and reader
+// keep a return address stack, so a return to the expected address costs a
+// single bit too. The full instruction stream is rebuilt by walking the
+// program's code from the start address.
+//
+// The file starts with the magic "RVB1" and the start pc (4 bytes, little
+// endian). Then follows a sequence of packets:
+//   0x01-0x7f  up to 6 outcome bits, oldest in bit 0, below a marker bit
+//   0x81       jalr target, zigzag varint offset from the jalr
+//   0x80       end: varint instruction count, then the end reason byte
+
+#define BTRACE_END    0x80
+#define BTRACE_TARGET 0x81
+
+struct btrace_writer;
+
+struct btrace_writer* btrace_writer_create(FILE* out, uint32_t start_pc);
+
+// conditional branch at any pc
+void btrace_branch(struct btrace_writer* bt, int taken);
+// jal/jalr at pc with the given rd, jumping to target
+void btrace_jal(struct btrace_writer* bt, uint32_t pc, int rd);
+void btrace_jalr(struct btrace_writer* bt, uint32_t pc, int rd, uint32_t target);
+
+// end of the trace after num_insns instructions; reason as in trace.h
+void btrace_end(struct btrace_writer* bt, long num_insns, int reason);
+
+// flush and delete the writer (the file is not closed)
+void btrace_writer_close(struct btrace_writer* bt);
+
+struct btrace_reader;
+
+// mem must hold the program the trace was taken from.
+// returns NULL if the file is not a branch trace
+struct btrace_reader* btrace_reader_open(FILE* in, struct memory* mem);
+
+// the next executed instruction; returns 0 after the last one
+int btrace_next(struct btrace_reader* br, uint32_t* pc, uint32_t* insn);
+
+// after the last instruction: end reason (-1 if the trace was cut short)
+int btrace_end_reason(struct btrace_reader* br);
+
+void btrace_reader_close(struct btrace_reader* br);
+
+#endif
@@ -0,0 +1,362 @@
+#include "cache.h"
+#include "insn.h"
+#include "pctable.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define WAY_VALID 1
+#define WAY_DIRTY 2
+
+struct way {
+    uint32_t tag;           // line number (address >> line bits)
+    uint32_t flags;
+    uint64_t last_use;      // LRU stamp
+};
+
+struct cache {
+    struct cache_config config;
+    int line_bits;
+    uint32_t set_mask;
+    struct way* ways;       // sets * assoc
+    uint64_t* plru_bits;    // one tree per set
+    uint64_t clock;
+    uint32_t random_state;
+    uint32_t last_fetch_line;
+    struct cache_stats stats;
+    struct pctable* misses; // pc -> struct miss_count
+};
+
+struct miss_count {
+    long misses;
+};
+
+static int log2_exact(long v)
+{
+    int bits = 0;
+    while ((1L << bits) < v)
+        bits++;
+    return (1L << bits) == v ? bits : -1;
+}
+
+long cache_parse_size(const char* s, char** end)
+{
+    long v = strtol(s, end, 10);
+    if (**end == 'k' || **end == 'K') {
+        v *= 1024;
+        (*end)++;
+    } else if (**end == 'm' || **end == 'M') {
+        v *= 1024 * 1024;
+        (*end)++;
+    }
+    return v;
+}
+
+int cache_parse_config(const char* spec, struct cache_config* config)
+{
+    char* end;
+    config->size = cache_parse_size(spec, &end);
+    if (*end++ != ':')
+        return -1;
+    config->line_size = cache_parse_size(end, &end);
+    if (*end++ != ':')
+        return -1;
+    if (config->line_size < 4 || log2_exact(config->line_size) < 0 || config->size < config->line_size)
+        return -1;
+    int lines = config->size / config->line_size;
+    if (!strncmp(end, "full", 4)) {
+        config->assoc = lines;
+        end += 4;
+    } else {
+        config->assoc = strtol(end, &end, 10);
+    }
+    if (config->assoc <= 0 || lines % config->assoc || log2_exact(lines / config->assoc) < 0)
+        return -1;
+    config->replacement = CACHE_LRU;
+    config->write_policy = CACHE_WRITE_BACK;
+    if (*end == ':') {
+        end++;
+        int len = strcspn(end, ":");
+        if (len == 3 && !strncmp(end, "lru", 3))
+            config->replacement = CACHE_LRU;
+        else if (len == 4 && !strncmp(end, "plru", 4))
+            config->replacement = CACHE_PLRU;
+        else if (len == 6 && !strncmp(end, "random", 6))
+            config->replacement = CACHE_RANDOM;
+        else
+            return -1;
+        end += len;
+    }
+    if (*end == ':') {
+        end++;
+        if (!strcmp(end, "wb"))
+            config->write_policy = CACHE_WRITE_BACK;
+        else if (!strcmp(end, "wt"))
+            config->write_policy = CACHE_WRITE_THROUGH;
+        else
+            return -1;
+        end += 2;
+    }
+    if (*end)
+        return -1;
+    if (config->replacement == CACHE_PLRU && (log2_exact(config->assoc) < 0 || config->assoc > 64))
+        return -1;
+    return 0;
+}
+
+struct cache* cache_create(const struct cache_config* config)
+{
+    struct cache* c = calloc(1, sizeof(struct cache));
+    c->config = *config;
+    c->line_bits = log2_exact(config->line_size);
+    int sets = config->size / config->line_size / config->assoc;
+    c->set_mask = sets - 1;
+    c->ways = calloc((size_t)sets * config->assoc, sizeof(struct way));
+    c->plru_bits = calloc(sets, sizeof(uint64_t));
+    c->random_state = 0x2545f491;
+    c->last_fetch_line = UINT32_MAX;
+    c->misses = pctable_create(sizeof(struct miss_count));
+    return c;
+}
+
+void cache_delete(struct cache* c)
+{
+    pctable_delete(c->misses);
+    free(c->plru_bits);
+    free(c->ways);
+    free(c);
+}
+
+// The PLRU tree has a bit per inner node, nodes numbered from 1 like a heap.
+// A bit points to the half which was not used most recently.
+static void plru_touch(struct cache* c, uint32_t set, int way)
+{
+    uint64_t bits = c->plru_bits[set];
+    int node = 1;
+    for (int half = c->config.assoc / 2; half >= 1; half /= 2) {
+        int right = (way & half) != 0;
+        if (right)
+            bits &= ~(1ULL << node);
+        else
+            bits |= 1ULL << node;
+        node = node * 2 + right;
+    }
+    c->plru_bits[set] = bits;
+}
+
+static int plru_victim(struct cache* c, uint32_t set)
+{
+    uint64_t bits = c->plru_bits[set];
+    int node = 1, way = 0;
+    for (int half = c->config.assoc / 2; half >= 1; half /= 2) {
+        int right = (bits >> node) & 1;
+        if (right)
+            way |= half;
+        node = node * 2 + right;
+    }
+    return way;
+}
+
+static int choose_victim(struct cache* c, uint32_t set, struct way* w)
+{
+    int assoc = c->config.assoc;
+    for (int i = 0; i < assoc; i++)
+        if (!(w[i].flags & WAY_VALID))
+            return i;
+    switch (c->config.replacement) {
+        case CACHE_PLRU:
+            return plru_victim(c, set);
+        case CACHE_RANDOM:
+            c->random_state ^= c->random_state << 13;
+            c->random_state ^= c->random_state >> 17;
+            c->random_state ^= c->random_state << 5;
+            return c->random_state % assoc;
+        default: {
+            int victim = 0;
+            for (int i = 1; i < assoc; i++)
+                if (w[i].last_use < w[victim].last_use)
+                    victim = i;
+            return victim;
+        }
+    }
+}
+
+static inline void touch(struct cache* c, uint32_t set, struct way* w, int i)
+{
+    w[i].last_use = ++c->clock;
+    if (c->config.replacement == CACHE_PLRU)
+        plru_touch(c, set, i);
+}
+
+int cache_access(struct cache* c, uint32_t pc, uint32_t addr, int is_write)
+{
+    uint32_t line = addr >> c->line_bits;
+    uint32_t set = line & c->set_mask;
+    int assoc = c->config.assoc;
+    struct way* w = &c->ways[(size_t)set * assoc];
+    int write_back = c->config.write_policy == CACHE_WRITE_BACK;
+    if (is_write)
+        c->stats.writes++;
+    else
+        c->stats.reads++;
+    for (int i = 0; i < assoc; i++) {
+        if (w[i].tag == line && (w[i].flags & WAY_VALID)) {
+            touch(c, set, w, i);
+            if (is_write) {
+                if (write_back)
+                    w[i].flags |= WAY_DIRTY;
+                else
+                    c->stats.mem_writes++;
+            }
+            return 1;
+        }
+    }
+    if (is_write)
+        c->stats.write_misses++;
+    else
+        c->stats.read_misses++;
+    ((struct miss_count*)pctable_get(c->misses, pc))->misses++;
+    if (is_write && !write_back) {
+        c->stats.mem_writes++;
+        return 0;
+    }
+    int victim = choose_victim(c, set, w);
+    if ((w[victim].flags & (WAY_VALID | WAY_DIRTY)) == (WAY_VALID | WAY_DIRTY))
+        c->stats.writebacks++;
+    w[victim].tag = line;
+    w[victim].flags = WAY_VALID | (is_write ? WAY_DIRTY : 0);
+    touch(c, set, w, victim);
+    return 0;
+}
+
+int cache_fetch(struct cache* c, uint32_t pc)
+{
+    uint32_t line = pc >> c->line_bits;
+    if (line == c->last_fetch_line) {
+        c->stats.reads++;
+        return 1;
+    }
+    c->last_fetch_line = line;
+    return cache_access(c, pc, pc, 0);
+}
+
+const struct cache_stats* cache_get_stats(struct cache* c)
+{
+    return &c->stats;
+}
+
+struct func_count {
+    uint32_t func;
+    long accesses;
+    long misses;
+};
+
+struct report_ctx {
+    struct memory* mem;
+    struct symbols* symbols;
+    int is_icache;
+    struct pctable* funcs;      // function start -> struct func_count
+};
+
+static struct func_count* func_count(struct report_ctx* ctx, uint32_t pc)
+{
+    unsigned int func = pc;
+    if (ctx->symbols == NULL || symbols_addr_to_func(ctx->symbols, pc, &func) == NULL)
+        func = pc;
+    struct func_count* fc = pctable_get(ctx->funcs, func);
+    fc->func = func;
+    return fc;
+}
+
+static void add_block(void* arg, uint32_t start, uint32_t end, long count)
+{
+    struct report_ctx* ctx = arg;
+    for (uint32_t pc = start; pc <= end; pc += 4) {
+        if (!ctx->is_icache) {
+            enum insn_class cls = insn_class(insn_decode(memory_rd_w(ctx->mem, pc)));
+            if (cls != CLASS_LOAD && cls != CLASS_STORE)
+                continue;
+        }
+        func_count(ctx, pc)->accesses += count;
+    }
+}
+
+static int compare_misses(const void* a, const void* b)
+{
+    const struct func_count* fa = a;
+    const struct func_count* fb = b;
+    if (fa->misses != fb->misses)
+        return fa->misses > fb->misses ? -1 : 1;
+    return fa->func < fb->func ? -1 : fa->func > fb->func;
+}
+
+static double ratio(long part, long total)
+{
+    return total ? 100.0 * part / total : 0.0;
+}
+
+static const char* replacement_name(enum cache_replacement r)
+{
+    switch (r) {
+        case CACHE_PLRU: return "PLRU";
+        case CACHE_RANDOM: return "random";
+        default: return "LRU";
+    }
+}
+
+void cache_write_report(struct cache* c, const char* name, int is_icache, struct block_counts* bc,
+                        struct memory* mem, struct symbols* symbols, FILE* out, int num_funcs)
+{
+    const struct cache_config* cfg = &c->config;
+    const struct cache_stats* s = &c->stats;
+    fprintf(out, "%s: %d bytes, %d byte lines, %d-way, %s, %s\n", name, cfg->size, cfg->line_size, cfg->assoc,
+            replacement_name(cfg->replacement), cfg->write_policy == CACHE_WRITE_BACK ? "write-back" : "write-through");
+    fprintf(out, "  reads:  %12ld  misses: %10ld  miss ratio: %6.2f%%\n", s->reads, s->read_misses,
+            ratio(s->read_misses, s->reads));
+    if (s->writes)
+        fprintf(out, "  writes: %12ld  misses: %10ld  miss ratio: %6.2f%%\n", s->writes, s->write_misses,
+                ratio(s->write_misses, s->writes));
+    fprintf(out, "  total:  %12ld  misses: %10ld  miss ratio: %6.2f%%\n", s->reads + s->writes,
+            s->read_misses + s->write_misses, ratio(s->read_misses + s->write_misses, s->reads + s->writes));
+    if (s->writes && cfg->write_policy == CACHE_WRITE_BACK)
+        fprintf(out, "  writebacks: %ld\n", s->writebacks);
+    else if (s->writes)
+        fprintf(out, "  memory writes: %ld\n", s->mem_writes);
+
+    struct report_ctx ctx = { mem, symbols, is_icache, pctable_create(sizeof(struct func_count)) };
+    if (bc)
+        block_counts_foreach(bc, add_block, &ctx);
+    int pos = 0;
+    uint32_t pc;
+    struct miss_count* mc;
+    while ((mc = pctable_next(c->misses, &pos, &pc)) != NULL)
+        func_count(&ctx, pc)->misses += mc->misses;
+
+    int n = pctable_count(ctx.funcs);
+    struct func_count* sorted = malloc((n + 1) * sizeof(struct func_count));
+    pos = 0;
+    for (int i = 0; i < n; i++)
+        sorted[i] = *(struct func_count*)pctable_next(ctx.funcs, &pos, NULL);
+    qsort(sorted, n, sizeof(struct func_count), compare_misses);
+
+    fprintf(out, "  misses by function:\n");
+    fprintf(out, "  %10s %12s %8s  %s\n", "misses", "accesses", "ratio", "function");
+    for (int i = 0; i < n && i < num_funcs && sorted[i].misses; i++) {
+        const char* func = NULL;
+        if (symbols) {
+            func = symbols_addr_to_func(symbols, sorted[i].func, NULL);
+            if (func == NULL)
+                func = symbols_value_to_sym(symbols, sorted[i].func);
+        }
+        fprintf(out, "  %10ld ", sorted[i].misses);
+        if (bc)
+            fprintf(out, "%12ld %7.2f%%  ", sorted[i].accesses, ratio(sorted[i].misses, sorted[i].accesses));
+        else
+            fprintf(out, "%12s %8s  ", "-", "-");
+        if (func)
+            fprintf(out, "%s\n", func);
+        else
+            fprintf(out, "0x%x\n", sorted[i].func);
+    }
+    free(sorted);
+    pctable_delete(ctx.funcs);
+}
@@ -0,0 +1,65 @@
+#ifndef __CACHE_H__
+#define __CACHE_H__
+
+#include "blocks.h"
+#include "memory.h"
+#include "read_elf.h"
+#include <stdint.h>
+#include <stdio.h>
+
+// Set associative cache model. It only tracks tags, data stays in memory.
+
+enum cache_replacement {
+    CACHE_LRU,
+    CACHE_PLRU,         // tree pseudo-LRU, needs a power of two ways
+    CACHE_RANDOM,
+};
+
+enum cache_write_policy {
+    CACHE_WRITE_BACK,       // write-allocate, dirty lines written on eviction
+    CACHE_WRITE_THROUGH,    // no-write-allocate, every store goes to memory
+};
+
+struct cache_config {
+    int size;           // bytes
+    int line_size;      // bytes, power of two
+    int assoc;          // ways, size / line_size for fully associative
+    enum cache_replacement replacement;
+    enum cache_write_policy write_policy;
+};
+
+struct cache_stats {
+    long reads;
+    long read_misses;
+    long writes;
+    long write_misses;
+    long writebacks;    // dirty lines evicted (write-back)
+    long mem_writes;    // stores passed on to memory (write-through)
+};
+
+// parse "size:line:assoc[:lru|plru|random[:wb|wt]]", e.g. "32k:64:4:lru:wb".
+// assoc may be "full". Returns 0, or -1 if the spec is not valid.
+int cache_parse_config(const char* spec, struct cache_config* config);
+
+// parse a size in bytes with an optional k or m suffix, like strtol
+long cache_parse_size(const char* s, char** end);
+
+struct cache* cache_create(const struct cache_config* config);
+void cache_delete(struct cache* c);
+
+// a load (is_write = 0) or store by the instruction at pc, returns 1 on a hit
+int cache_access(struct cache* c, uint32_t pc, uint32_t addr, int is_write);
+
+// an instruction fetch. Fetches from the same line as the previous one are
+// counted as hits without a lookup, as that line is the most recent.
+int cache_fetch(struct cache* c, uint32_t pc);
+
+const struct cache_stats* cache_get_stats(struct cache* c);
+
+// write totals and the functions with most misses. The accesses per
+// function are recomputed from the block counts, if bc is non-NULL;
+// is_icache says whether every instruction or only loads/stores access it.
+void cache_write_report(struct cache* c, const char* name, int is_icache, struct block_counts* bc,
+                        struct memory* mem, struct symbols* symbols, FILE* out, int num_funcs);
+
+#endif
@@ -0,0 +1,156 @@
+#include "callstack.h"
+#include <stdlib.h>
+
+struct cs_node {
+    uint32_t func;                  // entry address of the function
+    long samples;
+    struct cs_node* parent;
+    struct cs_node* first_child;
+    struct cs_node* next_sibling;
+};
+
+#define NODES_PER_CHUNK 1024
+
+struct cs_chunk {
+    struct cs_chunk* next;
+    int used;
+    struct cs_node nodes[NODES_PER_CHUNK];
+};
+
+struct callstack {
+    struct symbols* symbols;
+    struct cs_chunk* chunks;
+    struct cs_node* root;
+    struct cs_node* current;
+    // the open calls: where each returns to and the node to go back to
+    uint32_t* return_addrs;
+    struct cs_node** callers;
+    int depth;
+    int max_depth;
+};
+
+static struct cs_node* new_node(struct callstack* cs, uint32_t func, struct cs_node* parent)
+{
+    if (cs->chunks == NULL || cs->chunks->used == NODES_PER_CHUNK) {
+        struct cs_chunk* chunk = calloc(1, sizeof(struct cs_chunk));
+        chunk->next = cs->chunks;
+        cs->chunks = chunk;
+    }
+    struct cs_node* node = &cs->chunks->nodes[cs->chunks->used++];
+    node->func = func;
+    node->parent = parent;
+    if (parent) {
+        node->next_sibling = parent->first_child;
+        parent->first_child = node;
+    }
+    return node;
+}
+
+struct callstack* callstack_create(struct symbols* symbols, uint32_t start_addr)
+{
+    struct callstack* cs = calloc(1, sizeof(struct callstack));
+    cs->symbols = symbols;
+    unsigned int func = start_addr;
+    if (symbols)
+        symbols_addr_to_func(symbols, start_addr, &func);
+    cs->root = new_node(cs, func, NULL);
+    cs->current = cs->root;
+    cs->max_depth = 256;
+    cs->return_addrs = malloc(cs->max_depth * sizeof(uint32_t));
+    cs->callers = malloc(cs->max_depth * sizeof(struct cs_node*));
+    return cs;
+}
+
+void callstack_delete(struct callstack* cs)
+{
+    while (cs->chunks) {
+        struct cs_chunk* next = cs->chunks->next;
+        free(cs->chunks);
+        cs->chunks = next;
+    }
+    free(cs->return_addrs);
+    free(cs->callers);
+    free(cs);
+}
+
+void callstack_call(struct callstack* cs, uint32_t target, uint32_t return_addr)
+{
+    if (cs->depth == cs->max_depth) {
+        cs->max_depth *= 2;
+        cs->return_addrs = realloc(cs->return_addrs, cs->max_depth * sizeof(uint32_t));
+        cs->callers = realloc(cs->callers, cs->max_depth * sizeof(struct cs_node*));
+    }
+    cs->callers[cs->depth] = cs->current;
+    cs->return_addrs[cs->depth] = return_addr;
+    cs->depth++;
+    struct cs_node* child = cs->current->first_child;
+    while (child && child->func != target)
+        child = child->next_sibling;
+    if (child == NULL)
+        child = new_node(cs, target, cs->current);
+    cs->current = child;
+}
+
+int callstack_match_return(const uint32_t* return_addrs, int depth, uint32_t target)
+{
+    // usually the innermost call matches, but longjmp-like control flow may skip some
+    for (int i = depth - 1; i >= 0; i--)
+        if (return_addrs[i] == target)
+            return i;
+    return -1;
+}
+
+void callstack_return(struct callstack* cs, uint32_t target)
+{
+    int i = callstack_match_return(cs->return_addrs, cs->depth, target);
+    if (i >= 0) {
+        cs->current = cs->callers[i];
+        cs->depth = i;
+    }
+}
+
+void callstack_sample(struct callstack* cs)
+{
+    cs->current->samples++;
+}
+
+static void print_func_name(struct callstack* cs, uint32_t func, FILE* out)
+{
+    const char* name = NULL;
+    if (cs->symbols) {
+        name = symbols_value_to_sym(cs->symbols, func);
+        if (name == NULL)
+            name = symbols_addr_to_func(cs->symbols, func, NULL);
+    }
+    if (name)
+        fputs(name, out);
+    else
+        fprintf(out, "0x%x", func);
+}
+
+void callstack_write_folded(struct callstack* cs, FILE* out)
+{
+    int path_size = 256;
+    struct cs_node** path = malloc(path_size * sizeof(struct cs_node*));
+    for (struct cs_chunk* chunk = cs->chunks; chunk; chunk = chunk->next) {
+        for (int i = 0; i < chunk->used; i++) {
+            struct cs_node* node = &chunk->nodes[i];
+            if (node->samples == 0)
+                continue;
+            int len = 0;
+            for (struct cs_node* n = node; n; n = n->parent) {
+                if (len == path_size) {
+                    path_size *= 2;
+                    path = realloc(path, path_size * sizeof(struct cs_node*));
+                }
+                path[len++] = n;
+            }
+            while (len--) {
+                print_func_name(cs, path[len]->func, out);
+                fputc(len ? ';' : ' ', out);
+            }
+            fprintf(out, "%ld\n", node->samples);
+        }
+    }
+    free(path);
+}
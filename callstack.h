@@ -0,0 +1,33 @@
+#ifndef __CALLSTACK_H__
+#define __CALLSTACK_H__
+
+#include "read_elf.h"
+#include <stdint.h>
+#include <stdio.h>
+
+// Shadow call stack of the simulated program, built from calls (jal/jalr
+// with rd = ra) and returns (jalr x0, 0(ra)). Every distinct call path is a
+// node in a calling context tree, so taking a sample is a single increment.
+struct callstack;
+
+struct callstack* callstack_create(struct symbols* symbols, uint32_t start_addr);
+void callstack_delete(struct callstack* cs);
+
+// a call to 'target' which will return to 'return_addr'
+void callstack_call(struct callstack* cs, uint32_t target, uint32_t return_addr);
+// a return to 'target' - frames are popped until one expecting 'target' is found
+void callstack_return(struct callstack* cs, uint32_t target);
+
+// The call a return to 'target' belongs to, given the return addresses of
+// the open calls, innermost last: its index, which is also the depth after
+// the return, or -1 if no open call returns there. Shared with the timeline.
+int callstack_match_return(const uint32_t* return_addrs, int depth, uint32_t target);
+
+// count one sample at the current call path
+void callstack_sample(struct callstack* cs);
+
+// write samples in the folded stack format used by flamegraph tools:
+// "_start;main;fib;fib 1234"
+void callstack_write_folded(struct callstack* cs, FILE* out);
+
+#endif
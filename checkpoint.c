@@ -0,0 +1,278 @@
+#include "checkpoint.h"
+#include "console.h"
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define NUM_PAGES 0x10000
+#define PAGE_SIZE 0x10000
+#define BLOCK_SIZE 0x1000       // zero blocks of this size are left out
+#define MAX_MAPPINGS 16         // memory_map_file takes no more
+
+struct checkpoint_file {
+    int fd;
+    int flags;
+    long offset;
+    char* path;
+};
+
+struct checkpoint_mapping {
+    uint32_t addr;
+    uint32_t length;
+    uint32_t offset;
+    char* path;
+};
+
+struct checkpoint {
+    struct checkpoint_state state;
+    int num_files;
+    struct checkpoint_file files[FILE_TABLE_SIZE];
+    int num_mappings;
+    struct checkpoint_mapping mappings[MAX_MAPPINGS];
+    int unmapped;       // a file could not be mapped again
+    int input_len;
+    unsigned char* input;
+};
+
+static void put_u16(FILE* out, uint32_t v)
+{
+    fputc(v & 0xff, out);
+    fputc((v >> 8) & 0xff, out);
+}
+
+static void put_u32(FILE* out, uint32_t v)
+{
+    put_u16(out, v & 0xffff);
+    put_u16(out, v >> 16);
+}
+
+static void put_u64(FILE* out, uint64_t v)
+{
+    put_u32(out, (uint32_t)v);
+    put_u32(out, (uint32_t)(v >> 32));
+}
+
+// the readers leave *ok cleared at the end of the file
+static uint32_t get_u16(FILE* in, int* ok)
+{
+    int lo = fgetc(in);
+    int hi = fgetc(in);
+    if (hi == EOF)
+        *ok = 0;
+    return (lo & 0xff) | ((hi & 0xff) << 8);
+}
+
+static uint32_t get_u32(FILE* in, int* ok)
+{
+    uint32_t lo = get_u16(in, ok);
+    return lo | (get_u16(in, ok) << 16);
+}
+
+static uint64_t get_u64(FILE* in, int* ok)
+{
+    uint64_t lo = get_u32(in, ok);
+    return lo | ((uint64_t)get_u32(in, ok) << 32);
+}
+
+static int block_is_zero(const unsigned char* block)
+{
+    static const unsigned char zero[BLOCK_SIZE];
+    return memcmp(block, zero, BLOCK_SIZE) == 0;
+}
+
+int checkpoint_write(FILE* out, const struct checkpoint_state* state, struct memory* mem, struct file_table* ft)
+{
+    fwrite("RVC2", 1, 4, out);
+    put_u32(out, state->pc);
+    for (int i = 0; i < 32; i++)
+        put_u32(out, state->regs[i]);
+    put_u64(out, state->insns);
+    put_u64(out, state->branches);
+    put_u64(out, state->taken_branches);
+    put_u32(out, state->next_mmap_addr);
+
+    int num_files = 0;
+    const char* path;
+    int flags;
+    long offset;
+    for (int fd = 0; fd < FILE_TABLE_SIZE; fd++)
+        if (file_table_get_open(ft, fd, &path, &flags, &offset) == 0)
+            num_files++;
+    put_u32(out, num_files);
+    for (int fd = 0; fd < FILE_TABLE_SIZE; fd++) {
+        if (file_table_get_open(ft, fd, &path, &flags, &offset))
+            continue;
+        put_u32(out, fd);
+        put_u32(out, flags);
+        put_u64(out, offset);
+        put_u32(out, strlen(path));
+        fputs(path, out);
+    }
+
+    uint32_t addr, length, map_offset;
+    int num_mappings = 0;
+    while (file_table_get_mapping(ft, num_mappings, &path, &addr, &length, &map_offset) == 0)
+        num_mappings++;
+    put_u32(out, num_mappings);
+    for (int i = 0; i < num_mappings; i++) {
+        file_table_get_mapping(ft, i, &path, &addr, &length, &map_offset);
+        put_u32(out, addr);
+        put_u32(out, length);
+        put_u32(out, map_offset);
+        put_u32(out, strlen(path));
+        fputs(path, out);
+    }
+
+    const unsigned char* input;
+    int input_len = console_pending_input(&input);
+    put_u32(out, input_len);
+    fwrite(input, 1, input_len, out);
+
+    int num_pages = 0;
+    for (int page = 0; page < NUM_PAGES; page++)
+        if (memory_page_used(mem, page))
+            num_pages++;
+    put_u32(out, num_pages);
+    for (int page = 0; page < NUM_PAGES; page++) {
+        if (!memory_page_used(mem, page))
+            continue;
+        int len;
+        const unsigned char* data = memory_span(mem, page << 16, &len);
+        uint32_t mask = 0;
+        for (int b = 0; b < PAGE_SIZE / BLOCK_SIZE; b++)
+            if (!block_is_zero(data + b * BLOCK_SIZE))
+                mask |= 1u << b;
+        put_u16(out, page);
+        put_u16(out, mask);
+        for (int b = 0; b < PAGE_SIZE / BLOCK_SIZE; b++)
+            if (mask & (1u << b))
+                fwrite(data + b * BLOCK_SIZE, 1, BLOCK_SIZE, out);
+    }
+    fflush(out);
+    return ferror(out) ? -1 : 0;
+}
+
+struct checkpoint* checkpoint_read(FILE* in, struct memory* mem)
+{
+    char magic[4];
+    if (fread(magic, 1, 4, in) != 4 || memcmp(magic, "RVC2", 4) != 0)
+        return NULL;
+    struct checkpoint* cp = calloc(1, sizeof(struct checkpoint));
+    struct checkpoint_state* state = &cp->state;
+    int ok = 1;
+    state->pc = get_u32(in, &ok);
+    for (int i = 0; i < 32; i++)
+        state->regs[i] = get_u32(in, &ok);
+    state->insns = get_u64(in, &ok);
+    state->branches = get_u64(in, &ok);
+    state->taken_branches = get_u64(in, &ok);
+    state->next_mmap_addr = get_u32(in, &ok);
+
+    uint32_t num_files = get_u32(in, &ok);
+    if (num_files > FILE_TABLE_SIZE)
+        ok = 0;
+    for (uint32_t i = 0; ok && i < num_files; i++) {
+        struct checkpoint_file* f = &cp->files[cp->num_files++];
+        f->fd = get_u32(in, &ok);
+        f->flags = get_u32(in, &ok);
+        f->offset = get_u64(in, &ok);
+        uint32_t len = get_u32(in, &ok);
+        if (!ok || len > 4096) {
+            ok = 0;
+            break;
+        }
+        f->path = calloc(len + 1, 1);
+        if (fread(f->path, 1, len, in) != len)
+            ok = 0;
+    }
+
+    // the files are mapped before the pages go in, as mapping replaces them
+    uint32_t num_mappings = ok ? get_u32(in, &ok) : 0;
+    if (num_mappings > MAX_MAPPINGS)
+        ok = 0;
+    for (uint32_t i = 0; ok && i < num_mappings; i++) {
+        struct checkpoint_mapping* m = &cp->mappings[cp->num_mappings++];
+        m->addr = get_u32(in, &ok);
+        m->length = get_u32(in, &ok);
+        m->offset = get_u32(in, &ok);
+        uint32_t len = get_u32(in, &ok);
+        if (!ok || len > 4096) {
+            ok = 0;
+            break;
+        }
+        m->path = calloc(len + 1, 1);
+        if (fread(m->path, 1, len, in) != len) {
+            ok = 0;
+            break;
+        }
+        int fd = open(m->path, O_RDONLY);
+        if (fd < 0 || memory_map_file(mem, m->addr, m->length, fd, m->offset))
+            cp->unmapped = 1;
+        if (fd >= 0)
+            close(fd);
+    }
+
+    uint32_t input_len = ok ? get_u32(in, &ok) : 0;
+    if (input_len > 0x10000)
+        ok = 0;
+    if (ok) {
+        cp->input = malloc(input_len + 1);
+        cp->input_len = input_len;
+        if (fread(cp->input, 1, input_len, in) != input_len)
+            ok = 0;
+    }
+
+    uint32_t num_pages = ok ? get_u32(in, &ok) : 0;
+    for (uint32_t i = 0; ok && i < num_pages; i++) {
+        int page = get_u16(in, &ok);
+        uint32_t mask = get_u16(in, &ok);
+        int len;
+        unsigned char* data = memory_span(mem, page << 16, &len);
+        // the blocks left out are zero, whatever the program file put there
+        for (int b = 0; ok && b < PAGE_SIZE / BLOCK_SIZE; b++) {
+            if (!(mask & (1u << b)))
+                memset(data + b * BLOCK_SIZE, 0, BLOCK_SIZE);
+            else if (fread(data + b * BLOCK_SIZE, 1, BLOCK_SIZE, in) != BLOCK_SIZE)
+                ok = 0;
+        }
+    }
+    if (!ok) {
+        checkpoint_delete(cp);
+        return NULL;
+    }
+    return cp;
+}
+
+const struct checkpoint_state* checkpoint_get_state(struct checkpoint* cp)
+{
+    return &cp->state;
+}
+
+int checkpoint_resume_io(struct checkpoint* cp, struct file_table* ft)
+{
+    int result = 0;
+    for (int i = 0; i < cp->num_files; i++) {
+        struct checkpoint_file* f = &cp->files[i];
+        if (file_table_reopen(ft, f->fd, f->path, f->flags, f->offset))
+            result = -1;
+    }
+    for (int i = 0; i < cp->num_mappings; i++) {
+        struct checkpoint_mapping* m = &cp->mappings[i];
+        file_table_restore_mapping(ft, m->path, m->addr, m->length, m->offset);
+    }
+    if (cp->unmapped)
+        result = -1;
+    console_set_input(cp->input, cp->input_len);
+    return result;
+}
+
+void checkpoint_delete(struct checkpoint* cp)
+{
+    for (int i = 0; i < cp->num_files; i++)
+        free(cp->files[i].path);
+    for (int i = 0; i < cp->num_mappings; i++)
+        free(cp->mappings[i].path);
+    free(cp->input);
+    free(cp);
+}
@@ -0,0 +1,51 @@
+#ifndef __CHECKPOINT_H__
+#define __CHECKPOINT_H__
+
+#include "memory.h"
+#include "files.h"
+#include <stdint.h>
+#include <stdio.h>
+
+// Checkpoints of the simulated machine, to start runs from a point past a
+// long initialisation. The file starts with the magic "RVC2" followed by
+// (all little endian):
+//   the state below: pc, x0-x31 (4 bytes each), the three counts (8 bytes
+//   each) and the next mmap address (4 bytes)
+//   the open files: a count, then per file the guest number, open flags,
+//   offset (8 bytes) and the length and bytes of the path
+//   the mapped files: a count, then per mapping its address, length and file
+//   offset, and the length and bytes of the path
+//   the console input not yet read by the program: length and bytes
+//   the pages: a count, then per page its number and a mask of which of its
+//   16 4K blocks are non-zero (2 bytes each), and those blocks
+// Pages the program never touched are left out, also those of mapped files,
+// which are mapped again from the files. Zero blocks take no room.
+// Timing models and other instrumentation are not saved.
+struct checkpoint_state {
+    uint32_t pc;
+    uint32_t regs[32];
+    long insns;
+    long branches;
+    long taken_branches;
+    uint32_t next_mmap_addr;    // where mmap puts mappings without an address
+};
+
+// write a checkpoint of state, mem, the open files of ft and the console
+// input. Returns 0, or -1 if the file could not be written.
+int checkpoint_write(FILE* out, const struct checkpoint_state* state, struct memory* mem, struct file_table* ft);
+
+struct checkpoint;
+
+// read a checkpoint, mapping its files and storing its pages into mem. NULL
+// if it is not a checkpoint.
+struct checkpoint* checkpoint_read(FILE* in, struct memory* mem);
+
+const struct checkpoint_state* checkpoint_get_state(struct checkpoint* cp);
+
+// reopen the files of the checkpoint in ft and give the console its input.
+// Returns 0, or -1 if a file could not be opened or mapped again.
+int checkpoint_resume_io(struct checkpoint* cp, struct file_table* ft);
+
+void checkpoint_delete(struct checkpoint* cp);
+
+#endif
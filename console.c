@@ -0,0 +1,128 @@
+#include "console.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#define OUTPUT_SIZE (64 * 1024)
+#define INPUT_SIZE (64 * 1024)
+
+static char output[OUTPUT_SIZE];
+static int output_used;
+static int line_buffered = -1;     // unknown until the first character
+
+static unsigned char input[INPUT_SIZE];
+static int input_pos;
+static int input_len;
+
+void console_flush(void)
+{
+    if (output_used) {
+        // through stdio, so it stays in order with the simulator's own messages
+        fwrite(output, 1, output_used, stdout);
+        output_used = 0;
+    }
+    fflush(stdout);
+}
+
+void console_putchar(int c)
+{
+    if (line_buffered < 0)
+        line_buffered = isatty(STDOUT_FILENO);
+    output[output_used++] = c;
+    if (output_used == OUTPUT_SIZE || (c == '\n' && line_buffered))
+        console_flush();
+}
+
+void console_write(const void* buf, int len)
+{
+    if (line_buffered < 0)
+        line_buffered = isatty(STDOUT_FILENO);
+    const char* p = buf;
+    while (len > 0) {
+        int n = OUTPUT_SIZE - output_used;
+        if (n > len)
+            n = len;
+        memcpy(output + output_used, p, n);
+        output_used += n;
+        p += n;
+        len -= n;
+        if (output_used == OUTPUT_SIZE)
+            console_flush();
+    }
+    if (line_buffered && memchr(buf, '\n', p - (const char*)buf))
+        console_flush();
+}
+
+// make sure there is input, returns 0 at the end of input
+static int fill_input(void)
+{
+    // a prompt must be visible before we wait for the answer
+    if (output_used)
+        console_flush();
+    if (input_pos == input_len) {
+        ssize_t n = read(STDIN_FILENO, input, INPUT_SIZE);
+        if (n <= 0)
+            return 0;
+        input_pos = 0;
+        input_len = n;
+    }
+    return 1;
+}
+
+int console_getchar(void)
+{
+    if (!fill_input())
+        return EOF;
+    return input[input_pos++];
+}
+
+int console_read(void* buf, int len)
+{
+    if (len <= 0 || !fill_input())
+        return 0;
+    int n = input_len - input_pos;
+    if (n > len)
+        n = len;
+    unsigned char* newline = memchr(input + input_pos, '\n', n);
+    if (newline)
+        n = newline - (input + input_pos) + 1;
+    memcpy(buf, input + input_pos, n);
+    input_pos += n;
+    return n;
+}
+
+int console_pending_input(const unsigned char** data)
+{
+    *data = input + input_pos;
+    return input_len - input_pos;
+}
+
+void console_set_input(const void* buf, int len)
+{
+    if (len > INPUT_SIZE)
+        len = INPUT_SIZE;
+    memcpy(input, buf, len);
+    input_pos = 0;
+    input_len = len;
+}
+
+void console_drain_ring(struct memory* mem)
+{
+    uint32_t head = memory_rd_w(mem, CONSOLE_RING_HEAD);
+    uint32_t tail = memory_rd_w(mem, CONSOLE_RING_TAIL);
+    uint32_t pending = head - tail;
+    if (pending == 0)
+        return;
+    if (pending > CONSOLE_RING_SIZE)    // the guest broke the ring
+        pending = CONSOLE_RING_SIZE;
+    int span;
+    const unsigned char* data = memory_span(mem, CONSOLE_RING_DATA, &span);
+    uint32_t pos = tail & (CONSOLE_RING_SIZE - 1);
+    uint32_t first = CONSOLE_RING_SIZE - pos;
+    if (first > pending)
+        first = pending;
+    console_write(data + pos, first);
+    console_write(data, pending - first);
+    memory_wr_w(mem, CONSOLE_RING_TAIL, head);
+}
@@ -0,0 +1,49 @@
+#ifndef __CONSOLE_H__
+#define __CONSOLE_H__
+
+#include "memory.h"
+
+// Console I/O for the simulated program. Output is collected in a buffer
+// which is written when full, on newline if stdout is a terminal, before
+// reading input and on console_flush(). Input is read in large blocks.
+
+void console_putchar(int c);
+
+// flushes pending output first, returns EOF at the end of input
+int console_getchar(void);
+
+// copy len bytes to the output, like console_putchar for each
+void console_write(const void* buf, int len);
+
+// read up to len bytes, stopping after a newline like a terminal does.
+// Flushes pending output first, returns 0 at the end of input.
+int console_read(void* buf, int len);
+
+void console_flush(void);
+
+// For checkpoints: the input read from the host but not yet by the guest.
+// Returns the number of bytes at *data.
+int console_pending_input(const unsigned char** data);
+
+// start the input with len bytes from buf (at most 64K), before anything
+// has been read, as when the checkpoint was taken
+void console_set_input(const void* buf, int len);
+
+// Memory mapped console, a syscall free output path. The guest stores bytes
+// into the ring at CONSOLE_RING_DATA and then advances the count at
+// CONSOLE_RING_HEAD. The host copies new bytes to the output now and then at
+// a block boundary and advances CONSOLE_RING_TAIL. Both are free running
+// byte counts; the ring is full when they differ by CONSOLE_RING_SIZE.
+// The page sits between the program arguments at 0x1000000 and the heap.
+// It is only a console when the simulator is started with -O; otherwise
+// it is plain memory.
+#define CONSOLE_RING_BASE 0x1ff0000
+#define CONSOLE_RING_HEAD (CONSOLE_RING_BASE + 0)
+#define CONSOLE_RING_TAIL (CONSOLE_RING_BASE + 4)
+#define CONSOLE_RING_DATA (CONSOLE_RING_BASE + 0x1000)
+#define CONSOLE_RING_SIZE 0x8000
+
+// copy what the guest has put in the ring to the output
+void console_drain_ring(struct memory* mem);
+
+#endif
@@ -187,7 +187,7 @@ void disassemble(uint32_t addr, uint32_t instruction, char* result, size_t buf_s
     }
 
     // Add symbol information if available
-    const char* sym = symbols_value_to_sym(symbols, addr);
+    const char* sym = symbols ? symbols_value_to_sym(symbols, addr) : NULL;
     if (sym) {
         char temp[buf_size];
         snprintf(temp, buf_size, "%s ; %s", result, sym);
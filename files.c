@@ -0,0 +1,205 @@
+#include "files.h"
+#include "console.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#define MAX_MAPPED 16     // as many as memory_map_file takes
+
+struct file_mapping {
+    char* path;
+    uint32_t addr;
+    uint32_t length;
+    uint32_t offset;
+};
+
+struct file_table {
+    int host_fd[FILE_TABLE_SIZE];     // -1 when not open
+    char* path[FILE_TABLE_SIZE];      // as opened, for checkpoints
+    int flags[FILE_TABLE_SIZE];
+    struct file_mapping mapped[MAX_MAPPED];
+    int num_mapped;
+};
+
+struct file_table* file_table_create(void)
+{
+    struct file_table* ft = calloc(1, sizeof(struct file_table));
+    for (int i = 0; i < FILE_TABLE_SIZE; i++)
+        ft->host_fd[i] = i < 3 ? i : -1;
+    return ft;
+}
+
+void file_table_delete(struct file_table* ft)
+{
+    for (int i = 3; i < FILE_TABLE_SIZE; i++)
+        if (ft->host_fd[i] >= 0) {
+            close(ft->host_fd[i]);
+            free(ft->path[i]);
+        }
+    for (int i = 0; i < ft->num_mapped; i++)
+        free(ft->mapped[i].path);
+    free(ft);
+}
+
+int file_table_open(struct file_table* ft, const char* path, const char* mode)
+{
+    int flags;
+    switch (mode[0]) {
+        case 'r': flags = 0; break;
+        case 'w': flags = O_CREAT | O_TRUNC; break;
+        case 'a': flags = O_CREAT | O_APPEND; break;
+        default: return -1;
+    }
+    if (strchr(mode, '+'))
+        flags |= O_RDWR;
+    else
+        flags |= mode[0] == 'r' ? O_RDONLY : O_WRONLY;
+    int fd = 3;
+    while (fd < FILE_TABLE_SIZE && ft->host_fd[fd] >= 0)
+        fd++;
+    if (fd == FILE_TABLE_SIZE)
+        return -1;
+    int host_fd = open(path, flags, 0666);
+    if (host_fd < 0)
+        return -1;
+    ft->host_fd[fd] = host_fd;
+    ft->path[fd] = strdup(path);
+    ft->flags[fd] = flags;
+    return fd;
+}
+
+int file_table_close(struct file_table* ft, int fd)
+{
+    if (fd < 3 || fd >= FILE_TABLE_SIZE || ft->host_fd[fd] < 0)
+        return -1;
+    close(ft->host_fd[fd]);
+    ft->host_fd[fd] = -1;
+    free(ft->path[fd]);
+    ft->path[fd] = NULL;
+    return 0;
+}
+
+int file_table_host_fd(struct file_table* ft, int fd)
+{
+    return fd >= 0 && fd < FILE_TABLE_SIZE ? ft->host_fd[fd] : -1;
+}
+
+int32_t file_table_read(struct file_table* ft, struct memory* mem, int fd, uint32_t addr, int32_t len)
+{
+    int hfd = file_table_host_fd(ft, fd);
+    if (hfd < 0 || len < 0)
+        return -1;
+    int32_t done = 0;
+    while (done < len) {
+        int n;
+        unsigned char* p = memory_span(mem, addr + done, &n);
+        if (n > len - done)
+            n = len - done;
+        if (hfd == STDIN_FILENO) {
+            // the console answers with a line or what it has, like a terminal,
+            // also when the buffer goes on into the next page
+            const unsigned char* pending;
+            int got = console_read(p, n);
+            done += got;
+            if (got < n || p[got - 1] == '\n' || console_pending_input(&pending) == 0)
+                break;
+            continue;
+        }
+        ssize_t got = read(hfd, p, n);
+        if (got < 0)
+            return done ? done : -1;
+        done += got;
+        if (got < n)
+            break;
+    }
+    return done;
+}
+
+int32_t file_table_write(struct file_table* ft, struct memory* mem, int fd, uint32_t addr, int32_t len)
+{
+    int hfd = file_table_host_fd(ft, fd);
+    if (hfd < 0 || len < 0)
+        return -1;
+    // keep the console and other output in order
+    if (hfd != STDOUT_FILENO)
+        console_flush();
+    int32_t done = 0;
+    while (done < len) {
+        int n;
+        unsigned char* p = memory_span(mem, addr + done, &n);
+        if (n > len - done)
+            n = len - done;
+        if (hfd == STDOUT_FILENO) {
+            console_write(p, n);
+        } else {
+            ssize_t put = write(hfd, p, n);
+            if (put <= 0)
+                return done ? done : -1;
+            n = put;
+        }
+        done += n;
+    }
+    return done;
+}
+
+int file_table_get_open(struct file_table* ft, int fd, const char** path, int* flags, long* offset)
+{
+    if (fd < 3 || fd >= FILE_TABLE_SIZE || ft->host_fd[fd] < 0)
+        return -1;
+    *path = ft->path[fd];
+    *flags = ft->flags[fd];
+    *offset = lseek(ft->host_fd[fd], 0, SEEK_CUR);
+    return 0;
+}
+
+int file_table_reopen(struct file_table* ft, int fd, const char* path, int flags, long offset)
+{
+    if (fd < 3 || fd >= FILE_TABLE_SIZE || ft->host_fd[fd] >= 0)
+        return -1;
+    // the file was created and truncated when it was first opened
+    int host_fd = open(path, flags & ~(O_CREAT | O_TRUNC));
+    if (host_fd < 0)
+        return -1;
+    if (offset > 0 && lseek(host_fd, offset, SEEK_SET) < 0) {
+        close(host_fd);
+        return -1;
+    }
+    ft->host_fd[fd] = host_fd;
+    ft->path[fd] = strdup(path);
+    ft->flags[fd] = flags;
+    return 0;
+}
+
+void file_table_restore_mapping(struct file_table* ft, const char* path, uint32_t addr, uint32_t length,
+                                uint32_t offset)
+{
+    if (ft->num_mapped == MAX_MAPPED)
+        return;
+    struct file_mapping* m = &ft->mapped[ft->num_mapped++];
+    m->path = strdup(path);
+    m->addr = addr;
+    m->length = length;
+    m->offset = offset;
+}
+
+int file_table_add_mapping(struct file_table* ft, int fd, uint32_t addr, uint32_t length, uint32_t offset)
+{
+    if (fd < 3 || fd >= FILE_TABLE_SIZE || ft->host_fd[fd] < 0)
+        return -1;
+    file_table_restore_mapping(ft, ft->path[fd], addr, length, offset);
+    return 0;
+}
+
+int file_table_get_mapping(struct file_table* ft, int i, const char** path, uint32_t* addr,
+                           uint32_t* length, uint32_t* offset)
+{
+    if (i < 0 || i >= ft->num_mapped)
+        return -1;
+    *path = ft->mapped[i].path;
+    *addr = ft->mapped[i].addr;
+    *length = ft->mapped[i].length;
+    *offset = ft->mapped[i].offset;
+    return 0;
+}
@@ -0,0 +1,58 @@
+#ifndef __FILES_H__
+#define __FILES_H__
+
+#include "memory.h"
+#include <stdint.h>
+
+// Files opened by the simulated program. Guest file numbers index a table
+// of host file descriptors; 0, 1 and 2 are the console. Reads and writes
+// go directly between the host file and the guest pages, a page at a time.
+struct file_table;
+
+#define FILE_TABLE_SIZE 64      // guest file numbers are below this
+
+struct file_table* file_table_create(void);
+
+// closes all files still open
+void file_table_delete(struct file_table* ft);
+
+// open a file with an fopen() style mode ("r", "w", "a", "r+", ...),
+// returns the guest file number or -1
+int file_table_open(struct file_table* ft, const char* path, const char* mode);
+
+// returns 0, or -1 if fd is not open
+int file_table_close(struct file_table* ft, int fd);
+
+// the host file descriptor behind a guest file number, or -1
+int file_table_host_fd(struct file_table* ft, int fd);
+
+// read up to len bytes into guest memory at addr, returns the number of
+// bytes read (0 at end of file) or -1. The console returns at most a line.
+int32_t file_table_read(struct file_table* ft, struct memory* mem, int fd, uint32_t addr, int32_t len);
+
+// write len bytes from guest memory at addr, returns the number written or -1
+int32_t file_table_write(struct file_table* ft, struct memory* mem, int fd, uint32_t addr, int32_t len);
+
+// For checkpoints: the path, open() flags and current offset of guest file
+// fd. Returns 0, or -1 if fd is not an open file (the console is not).
+int file_table_get_open(struct file_table* ft, int fd, const char** path, int* flags, long* offset);
+
+// For checkpoints: remember that guest file fd was mapped at addr, so the
+// mapping can be made again from the file after a restore, also when the
+// program has closed fd since. Returns 0, or -1 if fd is not an open file.
+int file_table_add_mapping(struct file_table* ft, int fd, uint32_t addr, uint32_t length, uint32_t offset);
+
+// the path, address, length and file offset of mapping number i (from 0).
+// Returns 0, or -1 past the last mapping.
+int file_table_get_mapping(struct file_table* ft, int i, const char** path, uint32_t* addr,
+                           uint32_t* length, uint32_t* offset);
+
+// record a mapping made again from path after a restore
+void file_table_restore_mapping(struct file_table* ft, const char* path, uint32_t addr, uint32_t length,
+                                uint32_t offset);
+
+// open path as guest file fd at offset again, without creating or
+// truncating it. Returns 0, or -1 if fd is in use or the file can't be opened.
+int file_table_reopen(struct file_table* ft, int fd, const char* path, int flags, long offset);
+
+#endif
@@ -0,0 +1,117 @@
+#include "insn.h"
+#include "helper.h"
+
+static const struct {
+    const char* name;
+    enum insn_class cls;
+} insn_info[NUM_INSN_IDS] = {
+    [INSN_UNKNOWN] = {"unknown", CLASS_UNKNOWN},
+    [INSN_LUI] = {"lui", CLASS_ALU},      [INSN_AUIPC] = {"auipc", CLASS_ALU},
+    [INSN_JAL] = {"jal", CLASS_JUMP},     [INSN_JALR] = {"jalr", CLASS_JUMP},
+    [INSN_BEQ] = {"beq", CLASS_BRANCH},   [INSN_BNE] = {"bne", CLASS_BRANCH},
+    [INSN_BLT] = {"blt", CLASS_BRANCH},   [INSN_BGE] = {"bge", CLASS_BRANCH},
+    [INSN_BLTU] = {"bltu", CLASS_BRANCH}, [INSN_BGEU] = {"bgeu", CLASS_BRANCH},
+    [INSN_LB] = {"lb", CLASS_LOAD},       [INSN_LH] = {"lh", CLASS_LOAD},
+    [INSN_LW] = {"lw", CLASS_LOAD},       [INSN_LBU] = {"lbu", CLASS_LOAD},
+    [INSN_LHU] = {"lhu", CLASS_LOAD},
+    [INSN_SB] = {"sb", CLASS_STORE},      [INSN_SH] = {"sh", CLASS_STORE},
+    [INSN_SW] = {"sw", CLASS_STORE},
+    [INSN_ADDI] = {"addi", CLASS_ALU},    [INSN_SLTI] = {"slti", CLASS_ALU},
+    [INSN_SLTIU] = {"sltiu", CLASS_ALU},  [INSN_XORI] = {"xori", CLASS_ALU},
+    [INSN_ORI] = {"ori", CLASS_ALU},      [INSN_ANDI] = {"andi", CLASS_ALU},
+    [INSN_SLLI] = {"slli", CLASS_ALU},    [INSN_SRLI] = {"srli", CLASS_ALU},
+    [INSN_SRAI] = {"srai", CLASS_ALU},
+    [INSN_ADD] = {"add", CLASS_ALU},      [INSN_SUB] = {"sub", CLASS_ALU},
+    [INSN_SLL] = {"sll", CLASS_ALU},      [INSN_SLT] = {"slt", CLASS_ALU},
+    [INSN_SLTU] = {"sltu", CLASS_ALU},    [INSN_XOR] = {"xor", CLASS_ALU},
+    [INSN_SRL] = {"srl", CLASS_ALU},      [INSN_SRA] = {"sra", CLASS_ALU},
+    [INSN_OR] = {"or", CLASS_ALU},        [INSN_AND] = {"and", CLASS_ALU},
+    [INSN_MUL] = {"mul", CLASS_MUL},      [INSN_MULH] = {"mulh", CLASS_MUL},
+    [INSN_MULHSU] = {"mulhsu", CLASS_MUL}, [INSN_MULHU] = {"mulhu", CLASS_MUL},
+    [INSN_DIV] = {"div", CLASS_DIV},      [INSN_DIVU] = {"divu", CLASS_DIV},
+    [INSN_REM] = {"rem", CLASS_DIV},      [INSN_REMU] = {"remu", CLASS_DIV},
+    [INSN_ECALL] = {"ecall", CLASS_SYSTEM},
+};
+
+static const char* class_names[NUM_INSN_CLASSES] = {
+    "alu", "mul", "div", "load", "store", "branch", "jump", "system", "unknown"
+};
+
+enum insn_id insn_decode(uint32_t insn)
+{
+    uint32_t funct3 = get_bits(insn, 12, 3);
+    uint32_t funct7 = get_bits(insn, 25, 7);
+
+    switch (insn & 0x7F) {
+        case 0x37: return INSN_LUI;
+        case 0x17: return INSN_AUIPC;
+        case 0x6F: return INSN_JAL;
+        case 0x67: return funct3 == 0 ? INSN_JALR : INSN_UNKNOWN;
+        case 0x63: {
+            static const enum insn_id branches[8] = {
+                INSN_BEQ, INSN_BNE, INSN_UNKNOWN, INSN_UNKNOWN,
+                INSN_BLT, INSN_BGE, INSN_BLTU, INSN_BGEU
+            };
+            return branches[funct3];
+        }
+        case 0x03: {
+            static const enum insn_id loads[8] = {
+                INSN_LB, INSN_LH, INSN_LW, INSN_UNKNOWN,
+                INSN_LBU, INSN_LHU, INSN_UNKNOWN, INSN_UNKNOWN
+            };
+            return loads[funct3];
+        }
+        case 0x23: {
+            static const enum insn_id stores[8] = {
+                INSN_SB, INSN_SH, INSN_SW, INSN_UNKNOWN,
+                INSN_UNKNOWN, INSN_UNKNOWN, INSN_UNKNOWN, INSN_UNKNOWN
+            };
+            return stores[funct3];
+        }
+        case 0x13: {
+            static const enum insn_id alu_imm[8] = {
+                INSN_ADDI, INSN_SLLI, INSN_SLTI, INSN_SLTIU,
+                INSN_XORI, INSN_SRLI, INSN_ORI, INSN_ANDI
+            };
+            if (funct3 == 5 && (funct7 & 0x20))
+                return INSN_SRAI;
+            return alu_imm[funct3];
+        }
+        case 0x33: {
+            static const enum insn_id alu[8] = {
+                INSN_ADD, INSN_SLL, INSN_SLT, INSN_SLTU,
+                INSN_XOR, INSN_SRL, INSN_OR, INSN_AND
+            };
+            static const enum insn_id muldiv[8] = {
+                INSN_MUL, INSN_MULH, INSN_MULHSU, INSN_MULHU,
+                INSN_DIV, INSN_DIVU, INSN_REM, INSN_REMU
+            };
+            switch (funct7) {
+                case 0: return alu[funct3];
+                case 1: return muldiv[funct3];
+                case 32:
+                    if (funct3 == 0) return INSN_SUB;
+                    if (funct3 == 5) return INSN_SRA;
+                    return INSN_UNKNOWN;
+                default: return INSN_UNKNOWN;
+            }
+        }
+        case 0x73: return insn == 0x73 ? INSN_ECALL : INSN_UNKNOWN;
+        default: return INSN_UNKNOWN;
+    }
+}
+
+const char* insn_name(enum insn_id id)
+{
+    return insn_info[id].name;
+}
+
+enum insn_class insn_class(enum insn_id id)
+{
+    return insn_info[id].cls;
+}
+
+const char* insn_class_name(enum insn_class cls)
+{
+    return class_names[cls];
+}
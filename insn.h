@@ -0,0 +1,41 @@
+#ifndef __INSN_H__
+#define __INSN_H__
+
+#include <stdint.h>
+
+// Decoded instruction ids for RV32IM
+enum insn_id {
+    INSN_UNKNOWN,
+    INSN_LUI, INSN_AUIPC, INSN_JAL, INSN_JALR,
+    INSN_BEQ, INSN_BNE, INSN_BLT, INSN_BGE, INSN_BLTU, INSN_BGEU,
+    INSN_LB, INSN_LH, INSN_LW, INSN_LBU, INSN_LHU,
+    INSN_SB, INSN_SH, INSN_SW,
+    INSN_ADDI, INSN_SLTI, INSN_SLTIU, INSN_XORI, INSN_ORI, INSN_ANDI,
+    INSN_SLLI, INSN_SRLI, INSN_SRAI,
+    INSN_ADD, INSN_SUB, INSN_SLL, INSN_SLT, INSN_SLTU, INSN_XOR,
+    INSN_SRL, INSN_SRA, INSN_OR, INSN_AND,
+    INSN_MUL, INSN_MULH, INSN_MULHSU, INSN_MULHU,
+    INSN_DIV, INSN_DIVU, INSN_REM, INSN_REMU,
+    INSN_ECALL,
+    NUM_INSN_IDS
+};
+
+enum insn_class {
+    CLASS_ALU,
+    CLASS_MUL,
+    CLASS_DIV,
+    CLASS_LOAD,
+    CLASS_STORE,
+    CLASS_BRANCH,
+    CLASS_JUMP,
+    CLASS_SYSTEM,
+    CLASS_UNKNOWN,
+    NUM_INSN_CLASSES
+};
+
+enum insn_id insn_decode(uint32_t insn);
+const char* insn_name(enum insn_id id);
+enum insn_class insn_class(enum insn_id id);
+const char* insn_class_name(enum insn_class cls);
+
+#endif
@@ -0,0 +1,300 @@
+#include "insnlog.h"
+#include "insn.h"
+#include "disassemble.h"
+#include "helper.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define DESC_CACHE_SIZE 4096    // direct mapped, power of two
+#define TEXT_WIDTH 36           // disassembly column is padded to this
+
+enum effect {
+    EFFECT_NONE,
+    EFFECT_RD,          // writes rd
+    EFFECT_LOAD,
+    EFFECT_STORE,
+    EFFECT_BRANCH,
+    EFFECT_JUMP,        // jal, jalr: writes rd and goes to target
+    EFFECT_ECALL,       // may return a value in a0
+};
+
+// What is known about an instruction before it runs
+struct insn_desc {
+    uint32_t pc;
+    uint32_t insn;
+    int valid;
+    enum insn_id id;
+    enum effect effect;
+    int rd, rs1, rs2;
+    int32_t imm;
+    int size;           // bytes accessed by a load or store
+    int text_len;
+    char text[64];
+};
+
+struct insn_log {
+    FILE* out;
+    struct symbols* symbols;
+    struct insn_desc* descs;
+    // state between insn_log_before and insn_log_after
+    struct insn_desc* cur;
+    uint32_t rs1_value;
+    uint32_t rs2_value;
+    uint32_t a7_value;
+    uint32_t a0_value;
+};
+
+struct insn_log* insn_log_create(FILE* out, struct symbols* symbols)
+{
+    struct insn_log* log = calloc(1, sizeof(struct insn_log));
+    log->out = out;
+    log->symbols = symbols;
+    log->descs = calloc(DESC_CACHE_SIZE, sizeof(struct insn_desc));
+    return log;
+}
+
+void insn_log_delete(struct insn_log* log)
+{
+    free(log->descs);
+    free(log);
+}
+
+static int access_size(enum insn_id id)
+{
+    switch (id) {
+        case INSN_LB: case INSN_LBU: case INSN_SB: return 1;
+        case INSN_LH: case INSN_LHU: case INSN_SH: return 2;
+        default: return 4;
+    }
+}
+
+static void describe(struct insn_log* log, struct insn_desc* d, uint32_t pc, uint32_t insn)
+{
+    d->pc = pc;
+    d->insn = insn;
+    d->valid = 1;
+    d->id = insn_decode(insn);
+    d->rd = get_bits(insn, 7, 5);
+    d->rs1 = get_bits(insn, 15, 5);
+    d->rs2 = get_bits(insn, 20, 5);
+    d->imm = 0;
+    d->size = access_size(d->id);
+    switch (insn_class(d->id)) {
+        case CLASS_LOAD:
+            d->effect = EFFECT_LOAD;
+            d->imm = sign_extend(get_bits(insn, 20, 12), 12);
+            break;
+        case CLASS_STORE:
+            d->effect = EFFECT_STORE;
+            d->imm = sign_extend((get_bits(insn, 25, 7) << 5) | get_bits(insn, 7, 5), 12);
+            break;
+        case CLASS_BRANCH:
+            d->effect = EFFECT_BRANCH;
+            d->imm = sign_extend((get_bits(insn, 31, 1) << 12) | (get_bits(insn, 7, 1) << 11) |
+                                 (get_bits(insn, 25, 6) << 5) | (get_bits(insn, 8, 4) << 1), 13);
+            break;
+        case CLASS_JUMP:
+            d->effect = EFFECT_JUMP;
+            if (d->id == INSN_JAL)
+                d->imm = sign_extend((get_bits(insn, 31, 1) << 20) | (get_bits(insn, 12, 8) << 12) |
+                                     (get_bits(insn, 20, 1) << 11) | (get_bits(insn, 21, 10) << 1), 21);
+            else
+                d->imm = sign_extend(get_bits(insn, 20, 12), 12);
+            break;
+        case CLASS_SYSTEM:
+            d->effect = EFFECT_ECALL;
+            break;
+        case CLASS_UNKNOWN:
+            d->effect = EFFECT_NONE;
+            break;
+        default:
+            d->effect = EFFECT_RD;
+            break;
+    }
+    if (d->effect == EFFECT_RD && d->rd == 0)
+        d->effect = EFFECT_NONE;
+
+    disassemble(pc, insn, d->text, sizeof(d->text), log->symbols);
+    int len = strlen(d->text);
+    while (len < TEXT_WIDTH && len < (int)sizeof(d->text) - 1)
+        d->text[len++] = ' ';
+    d->text[len] = '\0';
+    d->text_len = len;
+}
+
+static struct insn_desc* lookup(struct insn_log* log, uint32_t pc, uint32_t insn)
+{
+    struct insn_desc* d = &log->descs[(pc >> 2) & (DESC_CACHE_SIZE - 1)];
+    if (!d->valid || d->pc != pc || d->insn != insn)
+        describe(log, d, pc, insn);
+    return d;
+}
+
+void insn_log_before(struct insn_log* log, uint32_t pc, uint32_t insn, const uint32_t regs[32])
+{
+    struct insn_desc* d = lookup(log, pc, insn);
+    log->cur = d;
+    log->rs1_value = regs[d->rs1];
+    log->rs2_value = regs[d->rs2];
+    log->a7_value = regs[17];
+    log->a0_value = regs[10];
+}
+
+static const char hex_digits[] = "0123456789abcdef";
+
+static char* put_hex(char* p, uint32_t v, int digits)
+{
+    for (int i = digits - 1; i >= 0; i--) {
+        p[i] = hex_digits[v & 0xf];
+        v >>= 4;
+    }
+    return p + digits;
+}
+
+// decimal, right aligned in width columns like "%*ld"
+static char* put_dec(char* p, long v, int width)
+{
+    char tmp[24];
+    int n = 0;
+    int negative = v < 0;
+    unsigned long u = negative ? -(unsigned long)v : (unsigned long)v;
+    do {
+        tmp[n++] = '0' + u % 10;
+        u /= 10;
+    } while (u);
+    if (negative) tmp[n++] = '-';
+    for (int i = n; i < width; i++) *p++ = ' ';
+    while (n) *p++ = tmp[--n];
+    return p;
+}
+
+static char* put_str(char* p, const char* s)
+{
+    size_t len = strlen(s);
+    memcpy(p, s, len);
+    return p + len;
+}
+
+// "count     pc : insn     disassembly"
+static char* put_prefix(char* p, long num_insns, uint32_t pc, uint32_t insn, const struct insn_desc* d)
+{
+    p = put_dec(p, num_insns, 8);
+    p = put_str(p, "     ");
+    p = put_hex(p, pc, 8);
+    p = put_str(p, " : ");
+    p = put_hex(p, insn, 8);
+    p = put_str(p, "     ");
+    memcpy(p, d->text, d->text_len);
+    return p + d->text_len;
+}
+
+static char* put_reg_write(char* p, int rd, uint32_t value)
+{
+    *p++ = 'x';
+    p = put_dec(p, rd, 0);
+    p = put_str(p, " <- ");
+    return put_hex(p, value, 8);
+}
+
+static int branch_taken(enum insn_id id, uint32_t a, uint32_t b)
+{
+    switch (id) {
+        case INSN_BEQ: return a == b;
+        case INSN_BNE: return a != b;
+        case INSN_BLT: return (int32_t)a < (int32_t)b;
+        case INSN_BGE: return (int32_t)a >= (int32_t)b;
+        case INSN_BLTU: return a < b;
+        case INSN_BGEU: return a >= b;
+        default: return 0;
+    }
+}
+
+void insn_log_after(struct insn_log* log, long num_insns, const uint32_t regs[32])
+{
+    const struct insn_desc* d = log->cur;
+    char line[256];
+    char* p = put_prefix(line, num_insns, d->pc, d->insn, d);
+    switch (d->effect) {
+        case EFFECT_NONE:
+            break;
+        case EFFECT_RD:
+            p = put_reg_write(p, d->rd, regs[d->rd]);
+            break;
+        case EFFECT_LOAD: {
+            uint32_t addr = log->rs1_value + d->imm;
+            if (d->rd != 0) {
+                p = put_reg_write(p, d->rd, regs[d->rd]);
+                p = put_str(p, "   ");
+            }
+            p = put_str(p, "M[");
+            p = put_hex(p, addr, 8);
+            p = put_str(p, "]");
+            if (d->rd != 0) {
+                p = put_str(p, " -> ");
+                p = put_hex(p, regs[d->rd], d->size * 2);
+            }
+            break;
+        }
+        case EFFECT_STORE: {
+            uint32_t addr = log->rs1_value + d->imm;
+            p = put_str(p, "M[");
+            p = put_hex(p, addr, 8);
+            p = put_str(p, "] <- ");
+            p = put_hex(p, log->rs2_value, d->size * 2);
+            break;
+        }
+        case EFFECT_BRANCH:
+            if (branch_taken(d->id, log->rs1_value, log->rs2_value)) {
+                p = put_str(p, "taken -> ");
+                p = put_hex(p, d->pc + d->imm, 8);
+            } else {
+                p = put_str(p, "not taken");
+            }
+            break;
+        case EFFECT_JUMP: {
+            uint32_t target = d->id == INSN_JAL ? d->pc + d->imm : (log->rs1_value + d->imm) & ~1u;
+            if (d->rd != 0) {
+                p = put_reg_write(p, d->rd, regs[d->rd]);
+                p = put_str(p, "   ");
+            }
+            p = put_str(p, "-> ");
+            p = put_hex(p, target, 8);
+            break;
+        }
+        case EFFECT_ECALL:
+            p = put_str(p, "syscall ");
+            p = put_dec(p, log->a7_value, 0);
+            if (regs[10] != log->a0_value) {
+                p = put_str(p, "   ");
+                p = put_reg_write(p, 10, regs[10]);
+            }
+            break;
+    }
+    // drop the padding when nothing follows the disassembly
+    while (p > line && p[-1] == ' ') p--;
+    *p++ = '\n';
+    fwrite(line, 1, p - line, log->out);
+}
+
+void insn_log_result(struct insn_log* log, long num_insns, uint32_t pc, uint32_t insn, uint32_t rd_value)
+{
+    const struct insn_desc* d = lookup(log, pc, insn);
+    char line[256];
+    char* p = put_prefix(line, num_insns, pc, insn, d);
+    int writes_rd = d->effect == EFFECT_RD || d->effect == EFFECT_LOAD || d->effect == EFFECT_JUMP;
+    if (writes_rd && d->rd != 0)
+        p = put_reg_write(p, d->rd, rd_value);
+    while (p > line && p[-1] == ' ') p--;
+    *p++ = '\n';
+    fwrite(line, 1, p - line, log->out);
+}
+
+void insn_log_plain(struct insn_log* log, long num_insns, uint32_t pc, uint32_t insn)
+{
+    const struct insn_desc* d = lookup(log, pc, insn);
+    char line[256];
+    char* p = put_prefix(line, num_insns, pc, insn, d);
+    while (p > line && p[-1] == ' ') p--;
+    *p++ = '\n';
+    fwrite(line, 1, p - line, log->out);
+}
@@ -0,0 +1,32 @@
+#ifndef __INSNLOG_H__
+#define __INSNLOG_H__
+
+#include <stdint.h>
+#include <stdio.h>
+
+struct symbols;
+
+// Text log of executed instructions, one line each:
+//   count     pc : insn     disassembly     effects
+// where the effects are the value written to rd, the address and data of a
+// load or store, or whether a branch was taken. Each instruction is decoded
+// and disassembled once into a descriptor kept in a table keyed by pc, so
+// logging an instruction only reads the registers it names and formats hex.
+struct insn_log;
+
+struct insn_log* insn_log_create(FILE* out, struct symbols* symbols);
+void insn_log_delete(struct insn_log* log);
+
+// call before executing the instruction; regs holds the registers before it
+void insn_log_before(struct insn_log* log, uint32_t pc, uint32_t insn, const uint32_t regs[32]);
+
+// call after executing it; regs holds the registers after it. Writes the line.
+void insn_log_after(struct insn_log* log, long num_insns, const uint32_t regs[32]);
+
+// write a line where only the value in rd after the instruction is known
+void insn_log_result(struct insn_log* log, long num_insns, uint32_t pc, uint32_t insn, uint32_t rd_value);
+
+// write a line without effects, when the register values are not known
+void insn_log_plain(struct insn_log* log, long num_insns, uint32_t pc, uint32_t insn);
+
+#endif
@@ -0,0 +1,93 @@
+#include "lineprof.h"
+#include "pctable.h"
+#include <stdlib.h>
+
+#define MAX_FILES 4096
+
+struct line_count {
+    const char* file;
+    int line;
+    long count;
+    uint32_t first_pc;
+};
+
+struct lineprof_ctx {
+    struct line_table* lines;
+    struct pctable* counts;     // (file index << 20 | line) -> struct line_count
+    const char* files[MAX_FILES];
+    int num_files;
+    long total;
+    long unknown;
+};
+
+static int file_index(struct lineprof_ctx* ctx, const char* file)
+{
+    for (int i = 0; i < ctx->num_files; i++)
+        if (ctx->files[i] == file)
+            return i;
+    if (ctx->num_files == MAX_FILES)
+        return MAX_FILES - 1;
+    ctx->files[ctx->num_files] = file;
+    return ctx->num_files++;
+}
+
+static void add_block(void* arg, uint32_t start, uint32_t end, long count)
+{
+    struct lineprof_ctx* ctx = arg;
+    for (uint32_t pc = start; pc <= end; pc += 4) {
+        const char* file;
+        int line;
+        ctx->total += count;
+        if (!lines_addr_to_line(ctx->lines, pc, &file, &line)) {
+            ctx->unknown += count;
+            continue;
+        }
+        uint32_t key = (uint32_t)file_index(ctx, file) << 20 | (line & 0xfffff);
+        struct line_count* lc = pctable_get(ctx->counts, key);
+        if (lc->count == 0) {
+            lc->file = file;
+            lc->line = line;
+            lc->first_pc = pc;
+        }
+        lc->count += count;
+    }
+}
+
+static int compare_count(const void* a, const void* b)
+{
+    const struct line_count* la = a;
+    const struct line_count* lb = b;
+    if (la->count != lb->count)
+        return la->count > lb->count ? -1 : 1;
+    return la->first_pc < lb->first_pc ? -1 : la->first_pc > lb->first_pc;
+}
+
+void lineprof_write(struct block_counts* bc, struct line_table* lines, struct symbols* symbols, FILE* out)
+{
+    struct lineprof_ctx* ctx = calloc(1, sizeof(struct lineprof_ctx));
+    ctx->lines = lines;
+    ctx->counts = pctable_create(sizeof(struct line_count));
+    block_counts_foreach(bc, add_block, ctx);
+
+    int n = pctable_count(ctx->counts);
+    struct line_count* sorted = malloc((n + 1) * sizeof(struct line_count));
+    int pos = 0;
+    for (int i = 0; i < n; i++)
+        sorted[i] = *(struct line_count*)pctable_next(ctx->counts, &pos, NULL);
+    qsort(sorted, n, sizeof(struct line_count), compare_count);
+
+    double scale = ctx->total ? 100.0 / ctx->total : 0.0;
+    fprintf(out, "Source line profile: %ld instructions executed, %ld without line information\n",
+            ctx->total, ctx->unknown);
+    fprintf(out, "%14s %7s  %-30s %s\n", "instructions", "%", "source line", "function");
+    for (int i = 0; i < n; i++) {
+        struct line_count* lc = &sorted[i];
+        char where[256];
+        snprintf(where, sizeof(where), "%s:%d", lc->file, lc->line);
+        const char* func = symbols ? symbols_addr_to_func(symbols, lc->first_pc, NULL) : NULL;
+        fprintf(out, "%14ld %7.2f  %-30s %s\n", lc->count, lc->count * scale, where, func ? func : "?");
+    }
+    free(sorted);
+    pctable_delete(ctx->counts);
+    free(ctx);
+}
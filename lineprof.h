@@ -0,0 +1,12 @@
+#ifndef __LINEPROF_H__
+#define __LINEPROF_H__
+
+#include "blocks.h"
+#include "read_elf.h"
+#include <stdio.h>
+
+// Executed instructions per source line, computed from basic block counts
+// and the .debug_line table of the program.
+void lineprof_write(struct block_counts* bc, struct line_table* lines, struct symbols* symbols, FILE* out);
+
+#endif
@@ -2,6 +2,9 @@
 #include "read_elf.h"
 #include "disassemble.h"
 #include "simulate.h"
+#include "opmix.h"
+#include "lineprof.h"
+#include "asyncfile.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -15,7 +18,45 @@ void terminate(const char *error)
   printf("    sim-options: options to the simulator\n");
   printf("      sim riscv-elf -d         // disassemble text segment of riscv-elf file to stdout\n");
   printf("      sim riscv-elf -l log     // simulate and log each instruction to file 'log'\n");
+  printf("      sim riscv-elf -L start   // start the -l log where a block starts at symbol or address 'start'\n");
+  printf("      sim riscv-elf -A N       // start the -l log after N instructions (with -L: first 'start' after N)\n");
+  printf("      sim riscv-elf -N M       // stop the -l log after M logged instructions\n");
+  printf("      sim riscv-elf -F func    // -l logs only instructions inside function 'func'\n");
   printf("      sim riscv-elf -s log     // simulate and log only summary to file 'log'\n");
+  printf("      sim riscv-elf -t trace   // simulate and write a compact binary trace to file 'trace' (see simtrace)\n");
+  printf("      sim riscv-elf -B trace   // simulate and write only branch outcomes and jump targets to 'trace'\n");
+  printf("      sim riscv-elf -f stacks  // sample call stacks to file 'stacks' in folded format (flamegraph)\n");
+  printf("      sim riscv-elf -i N       // take a call stack sample every N instructions (default 1000)\n");
+  printf("      sim riscv-elf -p prof    // sample the guest pc on a host timer, write profile to file 'prof'\n");
+  printf("      sim riscv-elf -P usec    // host CPU time between profile samples (default 1000)\n");
+  printf("      sim riscv-elf -T file    // write function spans as Chrome trace event JSON (Perfetto) to 'file'\n");
+  printf("      sim riscv-elf -I cfg     // model an instruction cache, cfg is size:line:assoc[:lru|plru|random[:wb|wt]]\n");
+  printf("      sim riscv-elf -D cfg     // model a data cache, e.g. -D 32k:64:4:lru:wb (assoc may be 'full')\n");
+  printf("      sim riscv-elf -S lines   // LRU data cache miss ratios of all sizes and associativities in one run,\n");
+  printf("                               // lines is line sizes and an optional largest size, e.g. -S 32,64:4m\n");
+  printf("      sim riscv-elf -C file    // write the cache reports to 'file' instead of stdout\n");
+  printf("      sim riscv-elf -b file    // write branch statistics and the hardest to predict branches to 'file'\n");
+  printf("      sim riscv-elf -R models  // run branch predictors, e.g. -R btfn,bimodal:12,gshare:14,tage,ras:16\n");
+  printf("                               // the report goes to the -b file if given, else stdout\n");
+  printf("      sim riscv-elf -c cfg     // time a 5 stage in-order pipeline, cfg is 'default' or key=value,...\n");
+  printf("                               // with keys mul, div, branch, jump, miss, e.g. -c mul=3,div=20,miss=10\n");
+  printf("      sim riscv-elf -j         // run the -I, -D, -S, -R and -c models on a second thread, in parallel\n");
+  printf("      sim riscv-elf -V file    // write basic block vectors for SimPoint (see simpoint) to 'file'\n");
+  printf("      sim riscv-elf -v N       // instructions per -V and -X interval (default 10000000)\n");
+  printf("      sim riscv-elf -X points  // time only the simulation points in file 'points' written by simpoint,\n");
+  printf("                               // and estimate the cycles of the whole run from them (-c default if no -c)\n");
+  printf("      sim riscv-elf -w N       // instructions of -X warmup before each simulation point (default 1000000)\n");
+  printf("      sim riscv-elf -W file    // stop at the -a position and write a checkpoint of the machine to 'file'\n");
+  printf("      sim riscv-elf -a at      // where -W stops: after 'at' instructions if it is a number, else where\n");
+  printf("                               // a block starts at symbol or 0x address 'at'\n");
+  printf("      sim riscv-elf -r file    // continue from the checkpoint in 'file' (the same riscv-elf)\n");
+  printf("                               // not with -V, the vectors must cover the whole run\n");
+  printf("      sim riscv-elf -O         // print what the program puts in the memory mapped console ring at 0x1ff0000\n");
+  printf("      sim riscv-elf -m file    // write the dynamic instruction mix as a table to 'file'\n");
+  printf("      sim riscv-elf -M file    // write the dynamic instruction mix as JSON to 'file'\n");
+  printf("      sim riscv-elf -g file    // write instructions executed per source line (needs -g guest) to 'file'\n");
+  printf("    the last instructions executed are written to stderr if the simulation stops at an\n");
+  printf("    unhandled instruction, or when the simulator receives SIGUSR1\n");
   printf("    prog-args: arguments to the simulated program\n");
   printf("               these arguments are provided through argv. Puts '--' in argv[0]\n");
   printf("      sim riscv-elf -- gylletank   // run riscv-elf with 'gylletank' in argv[1]\n");
@@ -65,73 +106,591 @@ void disassemble_to_stdout(struct memory* mem, struct program_info* prog_info, s
   }
 }
 
+// Helper function - opens an output file named on the command line
+FILE* open_output(const char* file_name, const char* error)
+{
+  FILE* file = fopen(file_name, "w");
+  if (file == NULL)
+  {
+    terminate(error);
+  }
+  return file;
+}
+
+// Helper function - opens an output file written by a separate thread,
+// for the log and trace files which can be large
+FILE* open_async_output(const char* file_name, const char* error)
+{
+  FILE* file = async_fopen(file_name, 16 << 20);
+  if (file == NULL)
+  {
+    terminate(error);
+  }
+  return file;
+}
+
+// Look up a code address given as a symbol name or a number.
+// The size of the symbol is stored in size, if non-NULL.
+uint32_t parse_address(struct symbols *symbols, const char *arg, unsigned int *size)
+{
+  unsigned int value;
+  if (symbols_sym_to_value(symbols, arg, &value, size))
+  {
+    if (size && *size == 0)
+    {
+      terminate("Symbol has no size");
+    }
+    return value;
+  }
+  char *end;
+  value = strtoul(arg, &end, 0);
+  if (*arg == '\0' || *end != '\0')
+  {
+    terminate("Unknown symbol");
+  }
+  if (size)
+  {
+    terminate("Not a function");
+  }
+  return value;
+}
+
 int main(int argc, char *argv[])
 {
   struct memory *mem = memory_create();
   argc = pass_args_to_program(mem, argc, argv);
-  if (argc == 2 || argc == 3 || argc == 4)
+  if (argc < 2)
+  {
+    terminate("Missing operands");
+  }
+  FILE *log_file = NULL;
+  FILE *prof_file = NULL;
+  FILE *folded_file = NULL;
+  FILE *branch_file = NULL;
+  FILE *mix_file = NULL;
+  FILE *mix_json_file = NULL;
+  FILE *line_file = NULL;
+  FILE *trace_file = NULL;
+  FILE *btrace_file = NULL;
+  FILE *timeline_file = NULL;
+  FILE *cache_file = NULL;
+  FILE *bbv_file = NULL;
+  FILE *checkpoint_file = NULL;
+  FILE *restore_file = NULL;
+  const char *checkpoint_at = NULL;
+  const char *points_name = NULL;
+  long bbv_interval = 10000000;
+  long warmup = 1000000;
+  const char *icache_spec = NULL;
+  const char *dcache_spec = NULL;
+  const char *sweep_spec = NULL;
+  const char *bpred_spec = NULL;
+  const char *pipeline_spec = NULL;
+  const char *summary_name = NULL;
+  int disassemble_only = 0;
+  int timing_thread = 0;
+  int console_ring = 0;
+  long sample_interval = 1000;
+  long profile_usec = 1000;
+  const char *log_start = NULL;
+  const char *log_func = NULL;
+  long log_after = 0;
+  long log_count = 0;
+  for (int i = 2; i < argc; ++i)
   {
-    FILE *log_file = NULL;
-    FILE *prof_file = NULL;
-    if (argc == 4 && !strcmp(argv[2], "-l"))
+    const char *opt = argv[i];
+    if (!strcmp(opt, "-d"))
+    {
+      disassemble_only = 1;
+      continue;
+    }
+    if (!strcmp(opt, "-j"))
+    {
+      timing_thread = 1;
+      continue;
+    }
+    if (!strcmp(opt, "-O"))
+    {
+      console_ring = 1;
+      continue;
+    }
+    if (i + 1 == argc)
+    {
+      terminate("Missing operands");
+    }
+    const char *arg = argv[++i];
+    if (!strcmp(opt, "-l"))
+      log_file = open_async_output(arg, "Could not open logfile, terminating.");
+    else if (!strcmp(opt, "-t"))
+      trace_file = open_async_output(arg, "Could not open trace file, terminating.");
+    else if (!strcmp(opt, "-B"))
+      btrace_file = open_async_output(arg, "Could not open trace file, terminating.");
+    else if (!strcmp(opt, "-T"))
+      timeline_file = open_output(arg, "Could not open file for timeline, terminating.");
+    else if (!strcmp(opt, "-I"))
+      icache_spec = arg;
+    else if (!strcmp(opt, "-D"))
+      dcache_spec = arg;
+    else if (!strcmp(opt, "-S"))
+      sweep_spec = arg;
+    else if (!strcmp(opt, "-C"))
+      cache_file = open_output(arg, "Could not open file for cache report, terminating.");
+    else if (!strcmp(opt, "-s"))
+      summary_name = arg;
+    else if (!strcmp(opt, "-p"))
+      prof_file = open_output(arg, "Could not open file for exec profile, terminating.");
+    else if (!strcmp(opt, "-f"))
+      folded_file = open_output(arg, "Could not open file for folded stacks, terminating.");
+    else if (!strcmp(opt, "-b"))
+      branch_file = open_output(arg, "Could not open file for branch statistics, terminating.");
+    else if (!strcmp(opt, "-R"))
+      bpred_spec = arg;
+    else if (!strcmp(opt, "-c"))
+      pipeline_spec = arg;
+    else if (!strcmp(opt, "-V"))
+      bbv_file = open_output(arg, "Could not open file for basic block vectors, terminating.");
+    else if (!strcmp(opt, "-W"))
+      checkpoint_file = open_output(arg, "Could not open file for checkpoint, terminating.");
+    else if (!strcmp(opt, "-a"))
+      checkpoint_at = arg;
+    else if (!strcmp(opt, "-r"))
+    {
+      restore_file = fopen(arg, "rb");
+      if (restore_file == NULL)
+      {
+        terminate("Could not open checkpoint, terminating.");
+      }
+    }
+    else if (!strcmp(opt, "-X"))
+      points_name = arg;
+    else if (!strcmp(opt, "-v"))
+    {
+      bbv_interval = atol(arg);
+      if (bbv_interval <= 0)
+      {
+        terminate("Interval must be positive");
+      }
+    }
+    else if (!strcmp(opt, "-w"))
+    {
+      warmup = atol(arg);
+      if (warmup < 0)
+      {
+        terminate("Warmup must not be negative");
+      }
+    }
+    else if (!strcmp(opt, "-m"))
+      mix_file = open_output(arg, "Could not open file for instruction mix, terminating.");
+    else if (!strcmp(opt, "-M"))
+      mix_json_file = open_output(arg, "Could not open file for instruction mix, terminating.");
+    else if (!strcmp(opt, "-g"))
+      line_file = open_output(arg, "Could not open file for source line profile, terminating.");
+    else if (!strcmp(opt, "-L"))
+      log_start = arg;
+    else if (!strcmp(opt, "-F"))
+      log_func = arg;
+    else if (!strcmp(opt, "-A"))
+    {
+      log_after = atol(arg);
+      if (log_after < 0)
+      {
+        terminate("Instruction count must not be negative");
+      }
+    }
+    else if (!strcmp(opt, "-N"))
     {
-      log_file = fopen(argv[3], "w");
-      if (log_file == NULL)
+      log_count = atol(arg);
+      if (log_count <= 0)
       {
-        terminate("Could not open logfile, terminating.");
+        terminate("Instruction count must be positive");
       }
     }
-    if (argc == 4 && !strcmp(argv[2], "-p"))
+    else if (!strcmp(opt, "-P"))
     {
-      prof_file = fopen(argv[3], "w");
-      if (prof_file == NULL)
+      profile_usec = atol(arg);
+      if (profile_usec <= 0)
       {
-        terminate("Could not open file for exec profile, terminating.");
+        terminate("Profile interval must be positive");
       }
     }
-    struct program_info prog_info;
-    int status = read_elf(mem, &prog_info, argv[1], log_file);
-    if (status) exit(status);
-    struct symbols* symbols = symbols_read_from_elf(argv[1]);
-    if (symbols == NULL) {
-      exit(-1);
+    else if (!strcmp(opt, "-i"))
+    {
+      sample_interval = atol(arg);
+      if (sample_interval <= 0)
+      {
+        terminate("Sample interval must be positive");
+      }
+    }
+    else
+      terminate("Unknown option");
+  }
+  struct program_info prog_info;
+  int status = read_elf(mem, &prog_info, argv[1], log_file);
+  if (status) exit(status);
+  struct symbols* symbols = symbols_read_from_elf(argv[1]);
+  if (symbols == NULL) {
+    exit(-1);
+  }
+  if (disassemble_only) {
+    // disassemble text segment to stdout
+    disassemble_to_stdout(mem, &prog_info, symbols);
+    exit(0);
+  }
+  int start_addr = prog_info.start;
+  struct sim_options opts = {0};
+  opts.timing_thread = timing_thread;
+  opts.console_ring = console_ring;
+  if (restore_file)
+  {
+    // the pages of the checkpoint replace those just loaded
+    opts.restore = checkpoint_read(restore_file, mem);
+    fclose(restore_file);
+    if (!opts.restore)
+    {
+      terminate("Not a checkpoint file, terminating.");
+    }
+    start_addr = checkpoint_get_state(opts.restore)->pc;
+    // the vectors number their intervals from the first one written, -X from
+    // the start of the program, so they have to come from a whole run
+    if (bbv_file)
+    {
+      terminate("Basic block vectors need a run from the start, -V can't be used with -r");
+    }
+  }
+  struct checkpoint_request checkpoint = {0};
+  if (checkpoint_file)
+  {
+    if (!checkpoint_at)
+    {
+      terminate("Missing checkpoint position, give it with -a");
+    }
+    if (*checkpoint_at && strspn(checkpoint_at, "0123456789") == strlen(checkpoint_at))
+    {
+      checkpoint.at_insn = atol(checkpoint_at);
+    }
+    else
+    {
+      checkpoint.has_pc = 1;
+      checkpoint.at_pc = parse_address(symbols, checkpoint_at, NULL);
+    }
+    checkpoint.out = checkpoint_file;
+    opts.checkpoint = &checkpoint;
+  }
+  if (folded_file)
+  {
+    opts.callstack = callstack_create(symbols, start_addr);
+    opts.sample_interval = sample_interval;
+  }
+  struct log_window log_window = {0};
+  if (log_file && (log_start || log_func || log_after || log_count))
+  {
+    log_window.start_insn = log_after;
+    log_window.max_insns = log_count;
+    log_window.func_end = UINT32_MAX;
+    if (log_start)
+    {
+      log_window.has_start_pc = 1;
+      log_window.start_pc = parse_address(symbols, log_start, NULL);
+    }
+    if (log_func)
+    {
+      unsigned int size;
+      log_window.func_start = parse_address(symbols, log_func, &size);
+      log_window.func_end = log_window.func_start + size;
+    }
+    opts.log_window = &log_window;
+  }
+  if (branch_file)
+  {
+    opts.branch_stats = branch_stats_create();
+  }
+  if (bpred_spec)
+  {
+    opts.bpred = bpred_create(bpred_spec);
+    if (!opts.bpred)
+    {
+      terminate("Invalid branch predictor models");
+    }
+  }
+  if (pipeline_spec)
+  {
+    struct pipeline_config config;
+    if (pipeline_parse_config(pipeline_spec, &config))
+    {
+      terminate("Invalid pipeline configuration");
+    }
+    opts.pipeline = pipeline_create(&config);
+  }
+  if (points_name)
+  {
+    opts.sample_plan = sample_plan_read(points_name, bbv_interval, warmup);
+    if (!opts.sample_plan)
+    {
+      terminate("Could not read simulation points");
     }
-    if (argc == 3 && !strcmp(argv[2], "-d")) {
-      // disassemble text segment to stdout
-      disassemble_to_stdout(mem, &prog_info, symbols);
-      exit(0);
+    if (!opts.pipeline)
+    {
+      struct pipeline_config config;
+      pipeline_parse_config("default", &config);
+      opts.pipeline = pipeline_create(&config);
     }
-    int start_addr = prog_info.start;
-    clock_t before = clock();
+  }
+  if (bbv_file)
+  {
+    opts.bbv = bbv_create(bbv_file, bbv_interval);
+  }
+  if (trace_file)
+  {
+    opts.trace = trace_writer_create(trace_file);
+  }
+  if (btrace_file)
+  {
+    opts.btrace = btrace_writer_create(btrace_file, start_addr);
+  }
+  if (timeline_file)
+  {
+    opts.timeline = timeline_create(timeline_file, symbols, start_addr);
+  }
+  if (icache_spec)
+  {
+    struct cache_config config;
+    if (cache_parse_config(icache_spec, &config))
+    {
+      terminate("Invalid instruction cache configuration");
+    }
+    opts.icache = cache_create(&config);
+  }
+  if (dcache_spec)
+  {
+    struct cache_config config;
+    if (cache_parse_config(dcache_spec, &config))
+    {
+      terminate("Invalid data cache configuration");
+    }
+    opts.dcache = cache_create(&config);
+  }
+  if (sweep_spec)
+  {
+    opts.stack_dist = stack_dist_create(sweep_spec);
+    if (!opts.stack_dist)
+    {
+      terminate("Invalid cache sweep, expected line sizes and an optional largest size");
+    }
+  }
+  // the cache report takes accesses per function from the block counts,
+  // which cover the whole run, so not with -X where the caches see part of it
+  if (mix_file || mix_json_file || line_file || ((opts.icache || opts.dcache) && !opts.sample_plan))
+  {
+    opts.blocks = block_counts_create();
+  }
+  if (prof_file)
+  {
+    opts.profile = profile_create(profile_usec);
+    profile_start(opts.profile);
+  }
+  // wall clock time, so the speedup of -j shows; CPU time counts all threads
+  struct timespec before, after;
+  clock_gettime(CLOCK_MONOTONIC, &before);
   printf("Starting simulation at address: 0x%x\n", start_addr);
-    struct Stat stats = simulate(mem, start_addr, log_file, symbols);
-printf("Simulation started with address: 0x%x\n", start_addr);
+  struct Stat stats = simulate(mem, start_addr, log_file, symbols, &opts);
+  if (opts.profile)
+  {
+    profile_stop(opts.profile);
+  }
+  printf("Simulation started with address: 0x%x\n", start_addr);
 
-    long int num_insns = stats.insns;
-    clock_t after = clock();
-    int ticks = after - before;
-    double mips = (1.0 * num_insns * CLOCKS_PER_SEC) / ticks / 1000000;
-    if (argc == 4 && !strcmp(argv[2], "-s"))
-    {
-      log_file = fopen(argv[3], "w");
-      if (log_file == NULL)
+  // instructions and branches simulated in this run, after those of a checkpoint
+  long int num_insns = stats.insns;
+  long int num_branches = stats.branches;
+  long int num_taken = stats.taken_branches;
+  if (opts.restore)
+  {
+    const struct checkpoint_state* restored = checkpoint_get_state(opts.restore);
+    num_insns -= restored->insns;
+    num_branches -= restored->branches;
+    num_taken -= restored->taken_branches;
+  }
+  // with -X the models only see the warmups and simulation points
+  long int model_insns = opts.sample_plan ? pipeline_get_stats(opts.pipeline)->insns : num_insns;
+  clock_gettime(CLOCK_MONOTONIC, &after);
+  double seconds = (after.tv_sec - before.tv_sec) + (after.tv_nsec - before.tv_nsec) / 1e9;
+  double mips = seconds > 0 ? num_insns / seconds / 1000000 : 0;
+  if (folded_file)
+  {
+    callstack_write_folded(opts.callstack, folded_file);
+    fclose(folded_file);
+    callstack_delete(opts.callstack);
+  }
+  if (trace_file)
+  {
+    trace_writer_close(opts.trace);
+    if (fclose(trace_file))
+    {
+      printf("Could not write all of the trace\n");
+    }
+  }
+  if (btrace_file)
+  {
+    btrace_writer_close(opts.btrace);
+    if (fclose(btrace_file))
+    {
+      printf("Could not write all of the trace\n");
+    }
+  }
+  if (timeline_file)
+  {
+    timeline_close(opts.timeline, stats.insns);
+    fclose(timeline_file);
+  }
+  if (checkpoint_file)
+  {
+    fclose(checkpoint_file);
+    if (checkpoint.written > 0)
+    {
+      printf("Checkpoint written after %ld instructions\n", stats.insns);
+    }
+    else if (checkpoint.written < 0)
+    {
+      printf("Could not write checkpoint\n");
+    }
+    else
+    {
+      printf("The program ended before the checkpoint was due\n");
+    }
+  }
+  if (opts.restore)
+  {
+    checkpoint_delete(opts.restore);
+  }
+  if (bbv_file)
+  {
+    bbv_delete(opts.bbv);
+    fclose(bbv_file);
+  }
+  if (branch_file)
+  {
+    branch_stats_write(opts.branch_stats, symbols, branch_file, 20);
+    branch_stats_delete(opts.branch_stats);
+  }
+  if (opts.bpred)
+  {
+    FILE *bpred_out = branch_file ? branch_file : stdout;
+    if (branch_file)
+    {
+      fprintf(bpred_out, "\n");
+    }
+    bpred_write_report(opts.bpred, symbols, model_insns, bpred_out, 20);
+    bpred_delete(opts.bpred);
+  }
+  if (branch_file)
+  {
+    fclose(branch_file);
+  }
+  FILE *cache_out = cache_file ? cache_file : stdout;
+  if (opts.blocks)
+  {
+    long mix[NUM_INSN_IDS];
+    opmix_from_blocks(opts.blocks, mem, mix);
+    if (mix_file)
+    {
+      opmix_write_table(mix, mix_file);
+      fclose(mix_file);
+    }
+    if (mix_json_file)
+    {
+      opmix_write_json(mix, mix_json_file);
+      fclose(mix_json_file);
+    }
+    if (line_file)
+    {
+      // the line table is only read when asked for
+      struct line_table* lines = lines_read_from_elf(argv[1]);
+      if (lines)
+      {
+        lineprof_write(opts.blocks, lines, symbols, line_file);
+        lines_delete(lines);
+      }
+      else
       {
-        terminate("Could not open logfile, terminating.");
+        fprintf(line_file, "No DWARF 5 .debug_line section in %s - build it with -g\n", argv[1]);
       }
+      fclose(line_file);
     }
-    if (log_file)
+  }
+  struct block_counts* cache_blocks = opts.sample_plan ? NULL : opts.blocks;
+  if (opts.icache)
+  {
+    cache_write_report(opts.icache, "I-cache", 1, cache_blocks, mem, symbols, cache_out, 20);
+    cache_delete(opts.icache);
+  }
+  if (opts.dcache)
+  {
+    cache_write_report(opts.dcache, "D-cache", 0, cache_blocks, mem, symbols, cache_out, 20);
+    cache_delete(opts.dcache);
+  }
+  if (opts.blocks)
+  {
+    block_counts_delete(opts.blocks);
+  }
+  if (opts.stack_dist)
+  {
+    stack_dist_write_report(opts.stack_dist, cache_out);
+    stack_dist_delete(opts.stack_dist);
+  }
+  if (cache_file)
+  {
+    fclose(cache_file);
+  }
+  if (prof_file)
+  {
+    profile_write(opts.profile, symbols, prof_file);
+    fclose(prof_file);
+    profile_delete(opts.profile);
+  }
+  if (summary_name)
+  {
+    log_file = open_output(summary_name, "Could not open logfile, terminating.");
+  }
+  if (log_file)
+  {
+    fprintf(log_file, "\nSimulated %ld instructions in %.3f seconds (%f MIPS)\n", num_insns, seconds, mips);
+    fprintf(log_file, "Branches: %ld, taken: %ld\n", num_branches, num_taken);
+    if (opts.pipeline)
     {
-      fprintf(log_file, "\nSimulated %ld instructions in %d host ticks (%f MIPS)\n", num_insns, ticks, mips);
-      fclose(log_file);
+      fprintf(log_file, "Cycles: %ld, CPI: %.3f\n", stats.cycles, num_insns ? (double)stats.cycles / num_insns : 0.0);
+      pipeline_write_report(opts.pipeline, log_file);
     }
-    else
+    if (opts.sample_plan)
     {
-      printf("\nSimulated %ld instructions in %d host ticks (%f MIPS)\n", num_insns, ticks, mips);
+      sample_plan_write_report(opts.sample_plan, opts.pipeline, num_insns, log_file);
+    }
+    if (fclose(log_file))
+    {
+      printf("Could not write all of the log\n");
     }
-    memory_delete(mem);
   }
-  else {
-    terminate("Missing operands");
-    memory_delete(mem);
+  else
+  {
+    printf("\nSimulated %ld instructions in %.3f seconds (%f MIPS)\n", num_insns, seconds, mips);
+    printf("Branches: %ld, taken: %ld\n", num_branches, num_taken);
+    if (opts.pipeline)
+    {
+      printf("Cycles: %ld, CPI: %.3f\n", stats.cycles, num_insns ? (double)stats.cycles / num_insns : 0.0);
+      pipeline_write_report(opts.pipeline, stdout);
+    }
+    if (opts.sample_plan)
+    {
+      sample_plan_write_report(opts.sample_plan, opts.pipeline, num_insns, stdout);
+    }
+  }
+  if (opts.sample_plan)
+  {
+    sample_plan_delete(opts.sample_plan);
+  }
+  if (opts.pipeline)
+  {
+    pipeline_delete(opts.pipeline);
   }
+  symbols_delete(symbols);
+  memory_delete(mem);
 }
@@ -1,10 +1,34 @@
 #include "memory.h"
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// memory_span hands out the pages as bytes, which are in guest order
+// only when the host is little endian like the guest
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "memory_span needs a little endian host"
+#endif
+
+// A host file mapped into guest memory. Its pages point into the host
+// mapping and are only hooked up when first touched.
+struct mapping
+{
+  int first_page;
+  int num_pages;
+  char *host;           // MAP_PRIVATE, so guest writes are copy-on-write
+  size_t host_length;
+  size_t file_length;   // bytes of the file from the start of the mapping
+};
+
+#define MAX_MAPPINGS 16
 
 struct memory
 {
   int *pages[0x10000];
+  struct mapping mappings[MAX_MAPPINGS];
+  int num_mappings;
 };
 
 struct memory *memory_create()
@@ -12,22 +36,61 @@ struct memory *memory_create()
   return calloc(1, sizeof(struct memory));
 }
 
+static struct mapping *find_mapping(struct memory *mem, int page_number)
+{
+  for (int i = 0; i < mem->num_mappings; ++i)
+  {
+    struct mapping *m = &mem->mappings[i];
+    if (page_number >= m->first_page && page_number < m->first_page + m->num_pages)
+      return m;
+  }
+  return NULL;
+}
+
+static int is_mapped_page(struct memory *mem, int page_number)
+{
+  struct mapping *m = find_mapping(mem, page_number);
+  if (m == NULL)
+    return 0;
+  char *page = (char *)mem->pages[page_number];
+  return page >= m->host && page < m->host + m->host_length;
+}
+
 void memory_delete(struct memory *mem)
 {
   for (int j = 0; j < 0x10000; ++j)
   {
-    if (mem->pages[j])
+    if (mem->pages[j] && !is_mapped_page(mem, j))
       free(mem->pages[j]);
   }
+  for (int i = 0; i < mem->num_mappings; ++i)
+    munmap(mem->mappings[i].host, mem->mappings[i].host_length);
   free(mem);
 }
 
+// first touch of a page in a mapping
+static int *fault_in(struct mapping *m, int page_number)
+{
+  size_t offset = (size_t)(page_number - m->first_page) << 16;
+  if (offset + 65536 <= m->file_length)
+    return (int *)(m->host + offset);
+  // the host mapping ends with the file, so the last page is a copy
+  int *page = calloc(65536, 1);
+  if (offset < m->file_length)
+    memcpy(page, m->host + offset, m->file_length - offset);
+  return page;
+}
+
 int *get_page(struct memory *mem, int addr)
 {
   int page_number = (addr >> 16) & 0x0ffff;
   if (mem->pages[page_number] == NULL)
   {
-    mem->pages[page_number] = calloc(65536, 1);
+    struct mapping *m = mem->num_mappings ? find_mapping(mem, page_number) : NULL;
+    if (m)
+      mem->pages[page_number] = fault_in(m, page_number);
+    else
+      mem->pages[page_number] = calloc(65536, 1);
   }
   return mem->pages[page_number];
 }
@@ -131,4 +194,56 @@ int memory_rd_b(struct memory *mem, int addr)
     break;
   }
   return 0; // silence a warning
-}
\ No newline at end of file
+}
+
+unsigned char *memory_span(struct memory *mem, int addr, int *len)
+{
+  int offset = addr & 0xffff;
+  *len = 65536 - offset;
+  return (unsigned char *)get_page(mem, addr) + offset;
+}
+
+int memory_map_file(struct memory *mem, int addr, int length, int host_fd, int offset)
+{
+  if ((addr & 0xffff) || (offset & 0xffff) || length <= 0 || offset < 0 || mem->num_mappings == MAX_MAPPINGS)
+    return -1;
+  int first_page = (addr >> 16) & 0xffff;
+  int num_pages = ((unsigned)length + 0xffff) >> 16;
+  if (first_page + num_pages > 0x10000)
+    return -1;
+  for (int j = first_page; j < first_page + num_pages; ++j)
+  {
+    if (find_mapping(mem, j))
+      return -1;
+  }
+  struct stat st;
+  if (fstat(host_fd, &st) || st.st_size <= offset)
+    return -1;
+  size_t file_length = st.st_size - offset;
+  if (file_length > (size_t)length)
+    file_length = length;
+  char *host = mmap(NULL, file_length, PROT_READ | PROT_WRITE, MAP_PRIVATE, host_fd, offset);
+  if (host == MAP_FAILED)
+    return -1;
+  struct mapping *m = &mem->mappings[mem->num_mappings++];
+  m->first_page = first_page;
+  m->num_pages = num_pages;
+  m->host = host;
+  m->host_length = file_length;
+  m->file_length = file_length;
+  // the mapping replaces what was there
+  for (int j = m->first_page; j < m->first_page + m->num_pages; ++j)
+  {
+    if (mem->pages[j])
+    {
+      free(mem->pages[j]);
+      mem->pages[j] = NULL;
+    }
+  }
+  return 0;
+}
+
+int memory_page_used(struct memory *mem, int page_number)
+{
+  return mem->pages[page_number] != NULL;
+}
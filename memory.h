@@ -16,4 +16,18 @@ void memory_wr_b(struct memory *mem, int addr, int data);
 int memory_rd_w(struct memory *mem, int addr);
 int memory_rd_h(struct memory *mem, int addr);
 int memory_rd_b(struct memory *mem, int addr);
+
+// direkte adgang til lagerets bytes fra addr og frem til slutningen af siden,
+// antallet af bytes gemmes i len - til kopiering af hele blokke ad gangen
+unsigned char *memory_span(struct memory *mem, int addr, int *len);
+
+// læg en værtsfil ind i lageret fra addr (begge på 64K grænser), copy-on-write.
+// Siderne peger direkte ind i filen og hentes først ved første brug.
+// Returnerer 0, eller -1 ved fejl
+int memory_map_file(struct memory *mem, int addr, int length, int host_fd, int offset);
+
+// er siden med nummer page_number (addr >> 16) i brug - rørt af programmet.
+// Urørte sider i en fil-mapping tæller ikke med. Til checkpoints, som springer
+// de andre over og laver mappingerne igen fra filerne
+int memory_page_used(struct memory *mem, int page_number);
 #endif
@@ -0,0 +1,90 @@
+#include "opmix.h"
+#include <stdlib.h>
+#include <string.h>
+
+struct mix_ctx {
+    struct memory* mem;
+    long* mix;
+};
+
+static void add_block(void* ctx, uint32_t start, uint32_t end, long count)
+{
+    struct mix_ctx* mc = ctx;
+    for (uint32_t pc = start; pc <= end; pc += 4)
+        mc->mix[insn_decode(memory_rd_w(mc->mem, pc))] += count;
+}
+
+void opmix_from_blocks(struct block_counts* bc, struct memory* mem, long mix[NUM_INSN_IDS])
+{
+    struct mix_ctx ctx = { mem, mix };
+    memset(mix, 0, NUM_INSN_IDS * sizeof(long));
+    block_counts_foreach(bc, add_block, &ctx);
+}
+
+static void class_totals(const long mix[NUM_INSN_IDS], long classes[NUM_INSN_CLASSES], long* total)
+{
+    memset(classes, 0, NUM_INSN_CLASSES * sizeof(long));
+    *total = 0;
+    for (int id = 0; id < NUM_INSN_IDS; id++) {
+        classes[insn_class(id)] += mix[id];
+        *total += mix[id];
+    }
+}
+
+static const long* sort_mix;
+
+static int compare_count(const void* a, const void* b)
+{
+    long ca = sort_mix[*(const int*)a];
+    long cb = sort_mix[*(const int*)b];
+    if (ca != cb)
+        return ca > cb ? -1 : 1;
+    return *(const int*)a - *(const int*)b;
+}
+
+void opmix_write_table(const long mix[NUM_INSN_IDS], FILE* out)
+{
+    long classes[NUM_INSN_CLASSES], total;
+    class_totals(mix, classes, &total);
+    double scale = total ? 100.0 / total : 0.0;
+
+    int order[NUM_INSN_IDS];
+    for (int id = 0; id < NUM_INSN_IDS; id++)
+        order[id] = id;
+    sort_mix = mix;
+    qsort(order, NUM_INSN_IDS, sizeof(int), compare_count);
+
+    fprintf(out, "Instruction mix: %ld instructions\n%14s %7s  %s\n", total, "count", "%", "insn");
+    for (int i = 0; i < NUM_INSN_IDS && mix[order[i]]; i++) {
+        int id = order[i];
+        fprintf(out, "%14ld %7.2f  %s\n", mix[id], mix[id] * scale, insn_name(id));
+    }
+    fprintf(out, "\nInstruction classes:\n%14s %7s  %s\n", "count", "%", "class");
+    for (int cls = 0; cls < NUM_INSN_CLASSES; cls++) {
+        if (classes[cls])
+            fprintf(out, "%14ld %7.2f  %s\n", classes[cls], classes[cls] * scale, insn_class_name(cls));
+    }
+}
+
+void opmix_write_json(const long mix[NUM_INSN_IDS], FILE* out)
+{
+    long classes[NUM_INSN_CLASSES], total;
+    class_totals(mix, classes, &total);
+    fprintf(out, "{\n  \"instructions\": %ld,\n  \"mix\": {", total);
+    const char* sep = "\n";
+    for (int id = 0; id < NUM_INSN_IDS; id++) {
+        if (mix[id]) {
+            fprintf(out, "%s    \"%s\": %ld", sep, insn_name(id), mix[id]);
+            sep = ",\n";
+        }
+    }
+    fprintf(out, "\n  },\n  \"classes\": {");
+    sep = "\n";
+    for (int cls = 0; cls < NUM_INSN_CLASSES; cls++) {
+        if (classes[cls]) {
+            fprintf(out, "%s    \"%s\": %ld", sep, insn_class_name(cls), classes[cls]);
+            sep = ",\n";
+        }
+    }
+    fprintf(out, "\n  }\n}\n");
+}
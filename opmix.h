@@ -0,0 +1,17 @@
+#ifndef __OPMIX_H__
+#define __OPMIX_H__
+
+#include "blocks.h"
+#include "insn.h"
+#include "memory.h"
+#include <stdio.h>
+
+// Dynamic instruction mix, indexed by enum insn_id. It is computed from the
+// basic block counts by decoding every block once, so the simulator only
+// pays per block, not per instruction.
+void opmix_from_blocks(struct block_counts* bc, struct memory* mem, long mix[NUM_INSN_IDS]);
+
+void opmix_write_table(const long mix[NUM_INSN_IDS], FILE* out);
+void opmix_write_json(const long mix[NUM_INSN_IDS], FILE* out);
+
+#endif
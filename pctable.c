@@ -0,0 +1,116 @@
+#include "pctable.h"
+#include <stdlib.h>
+#include <string.h>
+
+// each slot holds the key, an in-use flag and then the record
+struct slot {
+    uint32_t pc;
+    uint32_t used;
+};
+
+struct pctable {
+    size_t record_size;
+    size_t slot_size;
+    int capacity;       // always a power of two
+    int count;
+    char* slots;
+};
+
+static inline struct slot* slot_at(struct pctable* table, int index)
+{
+    return (struct slot*)(table->slots + index * table->slot_size);
+}
+
+static inline int hash_pc(uint32_t pc, int capacity)
+{
+    return ((pc >> 1) * 2654435761u) & (capacity - 1);
+}
+
+struct pctable* pctable_create(size_t record_size)
+{
+    struct pctable* table = malloc(sizeof(struct pctable));
+    table->record_size = record_size;
+    // keep records 8-byte aligned
+    table->slot_size = (sizeof(struct slot) + record_size + 7) & ~(size_t)7;
+    table->capacity = 1024;
+    table->count = 0;
+    table->slots = calloc(table->capacity, table->slot_size);
+    return table;
+}
+
+void pctable_delete(struct pctable* table)
+{
+    free(table->slots);
+    free(table);
+}
+
+static void grow(struct pctable* table)
+{
+    struct pctable old = *table;
+    table->capacity *= 2;
+    table->slots = calloc(table->capacity, table->slot_size);
+    for (int i = 0; i < old.capacity; i++) {
+        struct slot* from = slot_at(&old, i);
+        if (!from->used)
+            continue;
+        int index = hash_pc(from->pc, table->capacity);
+        while (slot_at(table, index)->used)
+            index = (index + 1) & (table->capacity - 1);
+        memcpy(slot_at(table, index), from, table->slot_size);
+    }
+    free(old.slots);
+}
+
+void* pctable_find(struct pctable* table, uint32_t pc)
+{
+    int index = hash_pc(pc, table->capacity);
+    for (;;) {
+        struct slot* s = slot_at(table, index);
+        if (!s->used)
+            return NULL;
+        if (s->pc == pc)
+            return s + 1;
+        index = (index + 1) & (table->capacity - 1);
+    }
+}
+
+void* pctable_get(struct pctable* table, uint32_t pc)
+{
+    int index = hash_pc(pc, table->capacity);
+    for (;;) {
+        struct slot* s = slot_at(table, index);
+        if (!s->used)
+            break;
+        if (s->pc == pc)
+            return s + 1;
+        index = (index + 1) & (table->capacity - 1);
+    }
+    // not found - insert, keeping the load factor at or below one half
+    if (2 * (table->count + 1) > table->capacity) {
+        grow(table);
+        return pctable_get(table, pc);
+    }
+    struct slot* s = slot_at(table, index);
+    s->pc = pc;
+    s->used = 1;
+    table->count++;
+    return s + 1;
+}
+
+int pctable_count(struct pctable* table)
+{
+    return table->count;
+}
+
+void* pctable_next(struct pctable* table, int* pos, uint32_t* pc)
+{
+    while (*pos < table->capacity) {
+        struct slot* s = slot_at(table, (*pos)++);
+        if (s->used) {
+            if (pc)
+                *pc = s->pc;
+            return s + 1;
+        }
+    }
+    return NULL;
+}
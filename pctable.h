@@ -0,0 +1,26 @@
+#ifndef __PCTABLE_H__
+#define __PCTABLE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Hash table from a guest address to a fixed size record. Records are
+// zeroed when first looked up. Pointers to records are only valid until
+// the next pctable_get, since the table may grow and move them.
+struct pctable;
+
+struct pctable* pctable_create(size_t record_size);
+void pctable_delete(struct pctable* table);
+
+// find the record for pc, creating it if needed
+void* pctable_get(struct pctable* table, uint32_t pc);
+
+// find the record for pc, NULL if there is none
+void* pctable_find(struct pctable* table, uint32_t pc);
+
+int pctable_count(struct pctable* table);
+
+// iterate over all records: start with *pos = 0, returns NULL when done
+void* pctable_next(struct pctable* table, int* pos, uint32_t* pc);
+
+#endif
@@ -0,0 +1,219 @@
+#include "pipeline.h"
+#include "insn.h"
+#include "helper.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define DESC_CACHE_SIZE 4096    // direct mapped, power of two
+
+// What the timing needs to know about an instruction, decoded once per pc
+struct pipe_desc {
+    uint32_t pc;
+    uint32_t insn;
+    int valid;
+    enum insn_class cls;
+    int rd;             // 0 if none
+    int rs1;            // 0 if not read
+    int rs2;            // 0 if not read
+};
+
+struct pipeline {
+    struct pipeline_config config;
+    struct pipe_desc* descs;
+    long next_ex;           // earliest cycle the next instruction can enter EX
+    long ready[32];         // cycle a register value can be forwarded to EX
+    enum insn_class producer[32];  // class of the instruction writing each register
+    struct pipeline_stats stats;
+};
+
+int pipeline_parse_config(const char* spec, struct pipeline_config* config)
+{
+    config->mul_latency = 3;
+    config->div_latency = 20;
+    config->branch_penalty = 2;
+    config->jump_penalty = 1;
+    config->miss_penalty = 10;
+    if (!strcmp(spec, "default"))
+        return 0;
+    const char* s = spec;
+    while (1) {
+        int key_len = strcspn(s, "=");
+        if (s[key_len] != '=')
+            return -1;
+        char* end;
+        long v = strtol(s + key_len + 1, &end, 10);
+        if (end == s + key_len + 1 || (*end != ',' && *end != '\0') || v < 0 || v > 1000)
+            return -1;
+        int* field;
+        if (key_len == 3 && !strncmp(s, "mul", 3))
+            field = &config->mul_latency;
+        else if (key_len == 3 && !strncmp(s, "div", 3))
+            field = &config->div_latency;
+        else if (key_len == 6 && !strncmp(s, "branch", 6))
+            field = &config->branch_penalty;
+        else if (key_len == 4 && !strncmp(s, "jump", 4))
+            field = &config->jump_penalty;
+        else if (key_len == 4 && !strncmp(s, "miss", 4))
+            field = &config->miss_penalty;
+        else
+            return -1;
+        *field = v;
+        if (*end == '\0')
+            break;
+        s = end + 1;
+    }
+    if (config->mul_latency < 1 || config->div_latency < 1)
+        return -1;
+    return 0;
+}
+
+struct pipeline* pipeline_create(const struct pipeline_config* config)
+{
+    struct pipeline* p = calloc(1, sizeof(struct pipeline));
+    p->config = *config;
+    p->descs = calloc(DESC_CACHE_SIZE, sizeof(struct pipe_desc));
+    p->next_ex = 3;     // IF in cycle 1, ID in cycle 2
+    return p;
+}
+
+void pipeline_delete(struct pipeline* p)
+{
+    free(p->descs);
+    free(p);
+}
+
+static void describe(struct pipe_desc* d, uint32_t pc, uint32_t insn)
+{
+    enum insn_id id = insn_decode(insn);
+    d->pc = pc;
+    d->insn = insn;
+    d->valid = 1;
+    d->cls = insn_class(id);
+    d->rd = get_bits(insn, 7, 5);
+    d->rs1 = get_bits(insn, 15, 5);
+    d->rs2 = get_bits(insn, 20, 5);
+    switch (d->cls) {
+        case CLASS_ALU:
+            if (id == INSN_LUI || id == INSN_AUIPC)
+                d->rs1 = 0;
+            if (id == INSN_LUI || id == INSN_AUIPC || (id >= INSN_ADDI && id <= INSN_SRAI))
+                d->rs2 = 0;     // immediate forms
+            break;
+        case CLASS_LOAD:
+            d->rs2 = 0;
+            break;
+        case CLASS_STORE:
+        case CLASS_BRANCH:
+            d->rd = 0;
+            break;
+        case CLASS_JUMP:
+            d->rs2 = 0;
+            if (id == INSN_JAL)
+                d->rs1 = 0;
+            break;
+        case CLASS_SYSTEM:      // ecall reads the number in a7 and arguments from a0
+            d->rd = 10;
+            d->rs1 = 17;
+            d->rs2 = 10;
+            break;
+        default:
+            d->rd = d->rs1 = d->rs2 = 0;
+            break;
+    }
+}
+
+void pipeline_insn(struct pipeline* p, uint32_t pc, uint32_t insn)
+{
+    struct pipe_desc* d = &p->descs[(pc >> 2) & (DESC_CACHE_SIZE - 1)];
+    if (!d->valid || d->pc != pc || d->insn != insn)
+        describe(d, pc, insn);
+
+    long t = p->next_ex;
+    // store data is only needed in MEM, a cycle after EX
+    long need2 = d->cls == CLASS_STORE ? p->ready[d->rs2] - 1 : p->ready[d->rs2];
+    int waits_for = p->ready[d->rs1] >= need2 ? d->rs1 : d->rs2;
+    long need = p->ready[d->rs1] >= need2 ? p->ready[d->rs1] : need2;
+    if (need > t) {
+        if (p->producer[waits_for] == CLASS_LOAD)
+            p->stats.load_use_stalls += need - t;
+        else
+            p->stats.muldiv_stalls += need - t;
+        t = need;
+    }
+    int latency = 1;
+    switch (d->cls) {
+        case CLASS_LOAD:
+            latency = 2;
+            break;
+        case CLASS_MUL:
+            latency = p->config.mul_latency;
+            break;
+        case CLASS_DIV:
+            latency = p->config.div_latency;
+            break;
+        default:
+            break;
+    }
+    if (d->rd) {
+        p->ready[d->rd] = t + latency;
+        p->producer[d->rd] = d->cls;
+    }
+    // multiplies and divides hold EX for their whole latency
+    long occupancy = d->cls == CLASS_MUL || d->cls == CLASS_DIV ? latency : 1;
+    p->stats.muldiv_stalls += occupancy - 1;
+    p->next_ex = t + occupancy;
+    p->stats.insns++;
+}
+
+void pipeline_mispredict(struct pipeline* p)
+{
+    p->next_ex += p->config.branch_penalty;
+    p->stats.branch_stalls += p->config.branch_penalty;
+}
+
+void pipeline_jump(struct pipeline* p)
+{
+    p->next_ex += p->config.jump_penalty;
+    p->stats.jump_stalls += p->config.jump_penalty;
+}
+
+void pipeline_cache_miss(struct pipeline* p, int is_data)
+{
+    p->next_ex += p->config.miss_penalty;
+    if (is_data)
+        p->stats.dcache_stalls += p->config.miss_penalty;
+    else
+        p->stats.icache_stalls += p->config.miss_penalty;
+}
+
+long pipeline_cycles(struct pipeline* p)
+{
+    // the last instruction entered EX at next_ex - 1 and leaves WB two cycles later
+    return p->stats.insns ? p->next_ex + 1 : 0;
+}
+
+const struct pipeline_stats* pipeline_get_stats(struct pipeline* p)
+{
+    p->stats.cycles = pipeline_cycles(p);
+    return &p->stats;
+}
+
+static void write_stall(FILE* out, const char* what, long stalls, long cycles)
+{
+    fprintf(out, "  %-22s %12ld  %6.2f%%\n", what, stalls, cycles ? 100.0 * stalls / cycles : 0.0);
+}
+
+void pipeline_write_report(struct pipeline* p, FILE* out)
+{
+    const struct pipeline_stats* s = pipeline_get_stats(p);
+    const struct pipeline_config* c = &p->config;
+    fprintf(out, "Pipeline: 5 stage in-order, mul %d, div %d, branch penalty %d, jump penalty %d, miss penalty %d\n",
+            c->mul_latency, c->div_latency, c->branch_penalty, c->jump_penalty, c->miss_penalty);
+    fprintf(out, "  %-22s %12s  %7s\n", "stall cycles", "", "of all");
+    write_stall(out, "load-use", s->load_use_stalls, s->cycles);
+    write_stall(out, "mul/div", s->muldiv_stalls, s->cycles);
+    write_stall(out, "branch mispredicts", s->branch_stalls, s->cycles);
+    write_stall(out, "jumps", s->jump_stalls, s->cycles);
+    write_stall(out, "instruction fetch", s->icache_stalls, s->cycles);
+    write_stall(out, "data cache", s->dcache_stalls, s->cycles);
+}
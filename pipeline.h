@@ -0,0 +1,58 @@
+#ifndef __PIPELINE_H__
+#define __PIPELINE_H__
+
+#include <stdint.h>
+#include <stdio.h>
+
+// Cycle approximate timing of a classic in-order 5 stage pipeline (IF ID EX
+// MEM WB) with full forwarding. Instructions enter EX in order, one per
+// cycle, unless a source register is not ready yet (a load result is ready
+// after MEM, so a dependent instruction right behind a load stalls a
+// cycle) or EX is busy with a multiply or divide. Branch mispredictions,
+// jumps and cache misses delay the following instructions by a penalty.
+struct pipeline_config {
+    int mul_latency;        // cycles in EX for MUL, MULH...
+    int div_latency;        // cycles in EX for DIV, REM...
+    int branch_penalty;     // cycles lost on a mispredicted branch or jalr
+    int jump_penalty;       // cycles lost on a jal, whose target is known in ID
+    int miss_penalty;       // cycles lost on an instruction or data cache miss
+};
+
+struct pipeline_stats {
+    long insns;
+    long cycles;
+    long load_use_stalls;
+    long muldiv_stalls;
+    long branch_stalls;     // mispredicted branches and jalr
+    long jump_stalls;
+    long icache_stalls;
+    long dcache_stalls;
+};
+
+// parse "key=value,..." with keys mul, div, branch, jump and miss, on top of
+// the defaults; "default" keeps them all. Returns 0, or -1 if not valid.
+int pipeline_parse_config(const char* spec, struct pipeline_config* config);
+
+struct pipeline* pipeline_create(const struct pipeline_config* config);
+void pipeline_delete(struct pipeline* p);
+
+// the instruction at pc enters the pipeline
+void pipeline_insn(struct pipeline* p, uint32_t pc, uint32_t insn);
+
+// the last conditional branch or jalr went the other way than predicted
+void pipeline_mispredict(struct pipeline* p);
+
+// the last instruction was a jal
+void pipeline_jump(struct pipeline* p);
+
+// the fetch of the next instruction (is_data = 0) or the last load or store missed
+void pipeline_cache_miss(struct pipeline* p, int is_data);
+
+// cycles until the last instruction has left WB
+long pipeline_cycles(struct pipeline* p);
+
+const struct pipeline_stats* pipeline_get_stats(struct pipeline* p);
+
+void pipeline_write_report(struct pipeline* p, FILE* out);
+
+#endif
@@ -0,0 +1,144 @@
+#include "profile.h"
+#include "pctable.h"
+#include "simulate.h"
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+struct profile {
+    long interval_usec;
+    long total;
+    struct pctable* samples;    // pc -> struct sample_count
+};
+
+struct sample_count {
+    long samples;
+};
+
+static volatile sig_atomic_t tick_pending;
+
+static void sigprof_handler(int sig)
+{
+    (void)sig;
+    tick_pending = 1;
+    simulate_interrupt();
+}
+
+struct profile* profile_create(long interval_usec)
+{
+    struct profile* prof = calloc(1, sizeof(struct profile));
+    prof->interval_usec = interval_usec;
+    prof->samples = pctable_create(sizeof(struct sample_count));
+    return prof;
+}
+
+void profile_delete(struct profile* prof)
+{
+    pctable_delete(prof->samples);
+    free(prof);
+}
+
+void profile_start(struct profile* prof)
+{
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = sigprof_handler;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGPROF, &action, NULL);
+
+    struct itimerval timer;
+    timer.it_interval.tv_sec = prof->interval_usec / 1000000;
+    timer.it_interval.tv_usec = prof->interval_usec % 1000000;
+    timer.it_value = timer.it_interval;
+    setitimer(ITIMER_PROF, &timer, NULL);
+}
+
+void profile_stop(struct profile* prof)
+{
+    (void)prof;
+    struct itimerval timer;
+    memset(&timer, 0, sizeof(timer));
+    setitimer(ITIMER_PROF, &timer, NULL);
+    signal(SIGPROF, SIG_IGN);
+}
+
+void profile_poll(struct profile* prof, uint32_t pc)
+{
+    if (tick_pending) {
+        tick_pending = 0;
+        struct sample_count* count = pctable_get(prof->samples, pc);
+        count->samples++;
+        prof->total++;
+    }
+}
+
+struct profile_line {
+    uint32_t addr;
+    long samples;
+    const char* name;
+    uint32_t func;
+};
+
+static int compare_samples(const void* a, const void* b)
+{
+    const struct profile_line* la = a;
+    const struct profile_line* lb = b;
+    if (la->samples != lb->samples)
+        return la->samples > lb->samples ? -1 : 1;
+    return la->addr < lb->addr ? -1 : la->addr > lb->addr;
+}
+
+void profile_write(struct profile* prof, struct symbols* symbols, FILE* out)
+{
+    int num_pcs = pctable_count(prof->samples);
+    struct profile_line* lines = malloc((num_pcs + 1) * sizeof(struct profile_line));
+    struct pctable* funcs = pctable_create(sizeof(struct profile_line));
+    int pos = 0, n = 0;
+    uint32_t pc;
+    struct sample_count* count;
+    while ((count = pctable_next(prof->samples, &pos, &pc))) {
+        struct profile_line* line = &lines[n++];
+        line->addr = pc;
+        line->samples = count->samples;
+        line->func = pc;
+        line->name = symbols ? symbols_addr_to_func(symbols, pc, &line->func) : NULL;
+        struct profile_line* func = pctable_get(funcs, line->func);
+        func->addr = line->func;
+        func->name = line->name;
+        func->samples += line->samples;
+    }
+    double scale = prof->total ? 100.0 / prof->total : 0.0;
+    fprintf(out, "Profile: %ld samples, one per %ld us of host CPU time\n", prof->total, prof->interval_usec);
+
+    int num_funcs = pctable_count(funcs);
+    struct profile_line* func_lines = malloc((num_funcs + 1) * sizeof(struct profile_line));
+    pos = 0;
+    for (int i = 0; i < num_funcs; i++)
+        func_lines[i] = *(struct profile_line*)pctable_next(funcs, &pos, NULL);
+    qsort(func_lines, num_funcs, sizeof(struct profile_line), compare_samples);
+    fprintf(out, "\nSamples by function:\n%10s %7s  %s\n", "samples", "%", "function");
+    for (int i = 0; i < num_funcs; i++) {
+        struct profile_line* f = &func_lines[i];
+        if (f->name)
+            fprintf(out, "%10ld %7.2f  %s\n", f->samples, f->samples * scale, f->name);
+        else
+            fprintf(out, "%10ld %7.2f  ?\n", f->samples, f->samples * scale);
+    }
+
+    qsort(lines, n, sizeof(struct profile_line), compare_samples);
+    fprintf(out, "\nSamples by address (pc at end of sampled basic block):\n%10s %7s  %8s  %s\n",
+            "samples", "%", "address", "location");
+    for (int i = 0; i < n; i++) {
+        struct profile_line* l = &lines[i];
+        fprintf(out, "%10ld %7.2f  %08x  ", l->samples, l->samples * scale, l->addr);
+        if (l->name)
+            fprintf(out, "%s+0x%x\n", l->name, l->addr - l->func);
+        else
+            fprintf(out, "?\n");
+    }
+    free(func_lines);
+    free(lines);
+    pctable_delete(funcs);
+}
@@ -0,0 +1,25 @@
+#ifndef __PROFILE_H__
+#define __PROFILE_H__
+
+#include "read_elf.h"
+#include <stdint.h>
+#include <stdio.h>
+
+// Statistical profiler. A SIGPROF interval timer marks that a sample is due,
+// and the simulator records the guest PC at the next basic block boundary.
+struct profile;
+
+struct profile* profile_create(long interval_usec);
+void profile_delete(struct profile* prof);
+
+// start/stop the host interval timer
+void profile_start(struct profile* prof);
+void profile_stop(struct profile* prof);
+
+// record a sample at pc if the timer has fired since the last call
+void profile_poll(struct profile* prof, uint32_t pc);
+
+// report samples by function and by address
+void profile_write(struct profile* prof, struct symbols* symbols, FILE* out);
+
+#endif
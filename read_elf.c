@@ -110,6 +110,8 @@ struct symbols {
     char* strtab;
     Elf32_Sym* symbols;
     int num_symbols;
+    Elf32_Sym** funcs;      // function symbols sorted by address, built on first lookup
+    int num_funcs;
 };
 
 struct symbols* symbols_read_from_elf(const char *filename) {
@@ -166,7 +168,7 @@ struct symbols* symbols_read_from_elf(const char *filename) {
         return NULL;
     }
 
-    struct symbols* symbols = malloc(sizeof(struct symbols));
+    struct symbols* symbols = calloc(1, sizeof(struct symbols));
     // Read the string table
     symbols->strtab = malloc(strtab_section->sh_size);
     fseek(file, strtab_section->sh_offset, SEEK_SET);
@@ -219,10 +221,426 @@ const char* symbols_value_to_sym(struct symbols* symbols, unsigned int value)
     return NULL;
 }
 
+int symbols_sym_to_value(struct symbols* symbols, const char* name, unsigned int* value, unsigned int* size)
+{
+    for (int i = 0; i < symbols->num_symbols; i++) {
+        if (symbols->symbols[i].st_name && !strcmp(&symbols->strtab[symbols->symbols[i].st_name], name)) {
+            *value = symbols->symbols[i].st_value;
+            if (size) *size = symbols->symbols[i].st_size;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int compare_func_addr(const void* a, const void* b)
+{
+    const Elf32_Sym* sa = *(const Elf32_Sym* const*)a;
+    const Elf32_Sym* sb = *(const Elf32_Sym* const*)b;
+    if (sa->st_value != sb->st_value)
+        return sa->st_value < sb->st_value ? -1 : 1;
+    return 0;
+}
+
+static void build_func_index(struct symbols* symbols)
+{
+    symbols->funcs = malloc((symbols->num_symbols + 1) * sizeof(Elf32_Sym*));
+    symbols->num_funcs = 0;
+    for (int i = 0; i < symbols->num_symbols; i++) {
+        Elf32_Sym* sym = &symbols->symbols[i];
+        if (ELF32_ST_TYPE(sym->st_info) == STT_FUNC && sym->st_value)
+            symbols->funcs[symbols->num_funcs++] = sym;
+    }
+    qsort(symbols->funcs, symbols->num_funcs, sizeof(Elf32_Sym*), compare_func_addr);
+}
+
+const char* symbols_addr_to_func(struct symbols* symbols, unsigned int addr, unsigned int* func_start)
+{
+    if (symbols->funcs == NULL)
+        build_func_index(symbols);
+    // binary search for the last function starting at or below addr
+    int lo = 0, hi = symbols->num_funcs - 1, found = -1;
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        if (symbols->funcs[mid]->st_value <= addr) {
+            found = mid;
+            lo = mid + 1;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    if (found < 0)
+        return NULL;
+    Elf32_Sym* sym = symbols->funcs[found];
+    // functions without a size (hand written assembly) cover everything up to the next one
+    if (sym->st_size && addr >= sym->st_value + sym->st_size)
+        return NULL;
+    if (func_start)
+        *func_start = sym->st_value;
+    return &symbols->strtab[sym->st_name];
+}
+
 void symbols_delete(struct symbols* symbols)
 {
+    free(symbols->funcs);
     free(symbols->strtab);
     free(symbols->symbols);
     free(symbols);
 }
 
+
+// Source line table built from the DWARF .debug_line section
+
+struct line_row {
+    unsigned int addr;
+    unsigned int line;      // 0 marks the end of a sequence
+    unsigned int file;      // index into files
+    unsigned int order;     // position in the line programs, breaks address ties
+};
+
+struct line_table {
+    struct line_row* rows;  // sorted by address
+    int num_rows;
+    char** files;
+    int num_files;
+};
+
+// Read the named section into a malloc'ed buffer, NULL if it is not present
+static unsigned char* read_section(FILE* file, const char* name, unsigned int* size)
+{
+    Elf32_Ehdr elf_header;
+    if (fseek(file, 0, SEEK_SET) || fread(&elf_header, sizeof(Elf32_Ehdr), 1, file) != 1)
+        return NULL;
+    if (memcmp(elf_header.e_ident, ELFMAG, SELFMAG) != 0 || elf_header.e_shstrndx >= elf_header.e_shnum)
+        return NULL;
+    Elf32_Shdr* section_headers = malloc(elf_header.e_shnum * sizeof(Elf32_Shdr));
+    fseek(file, elf_header.e_shoff, SEEK_SET);
+    if (fread(section_headers, sizeof(Elf32_Shdr), elf_header.e_shnum, file) != elf_header.e_shnum) {
+        free(section_headers);
+        return NULL;
+    }
+    Elf32_Shdr* names = &section_headers[elf_header.e_shstrndx];
+    char* shstrtab = malloc(names->sh_size + 1);
+    fseek(file, names->sh_offset, SEEK_SET);
+    shstrtab[fread(shstrtab, 1, names->sh_size, file)] = '\0';
+    unsigned char* data = NULL;
+    for (int i = 0; i < elf_header.e_shnum; i++) {
+        Elf32_Shdr* section = &section_headers[i];
+        if (section->sh_name < names->sh_size && !strcmp(&shstrtab[section->sh_name], name)) {
+            data = malloc(section->sh_size + 1);
+            fseek(file, section->sh_offset, SEEK_SET);
+            if (fread(data, 1, section->sh_size, file) != section->sh_size) {
+                free(data);
+                data = NULL;
+            } else {
+                data[section->sh_size] = 0;
+                *size = section->sh_size;
+            }
+            break;
+        }
+    }
+    free(shstrtab);
+    free(section_headers);
+    return data;
+}
+
+// Cursor over DWARF data, reads past the end yield zeroes
+struct dwarf_cursor {
+    const unsigned char* p;
+    const unsigned char* end;
+};
+
+static unsigned int read_u8(struct dwarf_cursor* c)
+{
+    return c->p < c->end ? *c->p++ : 0;
+}
+
+static unsigned int read_uint(struct dwarf_cursor* c, int bytes)
+{
+    unsigned int value = 0;
+    for (int i = 0; i < bytes; i++) {
+        unsigned int byte = read_u8(c);
+        if (i < 4)
+            value |= byte << (8 * i);
+    }
+    return value;
+}
+
+static unsigned int read_uleb(struct dwarf_cursor* c)
+{
+    unsigned int value = 0;
+    int shift = 0;
+    unsigned int byte;
+    do {
+        byte = read_u8(c);
+        if (shift < 32)
+            value |= (byte & 0x7f) << shift;
+        shift += 7;
+    } while ((byte & 0x80) && c->p < c->end);
+    return value;
+}
+
+static int read_sleb(struct dwarf_cursor* c)
+{
+    int value = 0;
+    int shift = 0;
+    unsigned int byte;
+    do {
+        byte = read_u8(c);
+        if (shift < 32)
+            value |= (byte & 0x7f) << shift;
+        shift += 7;
+    } while ((byte & 0x80) && c->p < c->end);
+    if (shift < 32 && (byte & 0x40))
+        value |= -(1 << shift);
+    return value;
+}
+
+static const char* read_cstr(struct dwarf_cursor* c)
+{
+    const char* s = (const char*)c->p;
+    while (c->p < c->end && *c->p)
+        c->p++;
+    if (c->p < c->end)
+        c->p++;
+    return s;
+}
+
+// Read an attribute of a directory/file entry in the forms gas and gcc use
+// for them. Paths are returned, numbers are stored in *value. Returns NULL
+// with the cursor at the end on any other form.
+static const char* read_form(struct dwarf_cursor* c, unsigned int form, unsigned int* value,
+                             const unsigned char* line_str, unsigned int line_str_size)
+{
+    unsigned int offset;
+    *value = 0;
+    switch (form) {
+        case 0x08: return read_cstr(c);                               // DW_FORM_string
+        case 0x1f:                                                    // DW_FORM_line_strp
+            offset = read_uint(c, 4);
+            return offset < line_str_size ? (const char*)line_str + offset : NULL;
+        case 0x0f: *value = read_uleb(c); return NULL;                // DW_FORM_udata
+        case 0x1e:                                                    // DW_FORM_data16, the MD5
+            c->p = c->end - c->p >= 16 ? c->p + 16 : c->end;
+            return NULL;
+        default: c->p = c->end; return NULL;
+    }
+}
+
+static void add_file(struct line_table* table, int* capacity, const char* dir, const char* name)
+{
+    if (table->num_files == *capacity) {
+        *capacity *= 2;
+        table->files = realloc(table->files, *capacity * sizeof(char*));
+    }
+    if (name == NULL)
+        name = "?";
+    char* path;
+    if (dir && *dir && name[0] != '/') {
+        path = malloc(strlen(dir) + strlen(name) + 2);
+        sprintf(path, "%s/%s", dir, name);
+    } else {
+        path = strdup(name);
+    }
+    table->files[table->num_files++] = path;
+}
+
+static void add_row(struct line_table* table, int* capacity, unsigned int addr, unsigned int line, unsigned int file)
+{
+    if (table->num_rows == *capacity) {
+        *capacity *= 2;
+        table->rows = realloc(table->rows, *capacity * sizeof(struct line_row));
+    }
+    struct line_row* row = &table->rows[table->num_rows];
+    row->addr = addr;
+    row->line = line;
+    row->file = file;
+    row->order = table->num_rows++;
+}
+
+static int compare_rows(const void* a, const void* b)
+{
+    const struct line_row* ra = a;
+    const struct line_row* rb = b;
+    if (ra->addr != rb->addr)
+        return ra->addr < rb->addr ? -1 : 1;
+    // at equal addresses the end of one sequence goes before the start of the next
+    if ((ra->line == 0) != (rb->line == 0))
+        return ra->line == 0 ? -1 : 1;
+    return ra->order < rb->order ? -1 : 1;
+}
+
+// Run the line number programs of all compilation units. Only DWARF 5 is
+// read, which is what the gcc 12 and 14 of test_files/gcc emit for -g;
+// units of other versions are skipped.
+static void parse_debug_line(struct line_table* table, const unsigned char* data, unsigned int size,
+                             const unsigned char* line_str, unsigned int line_str_size)
+{
+    int row_capacity = 1024, file_capacity = 16;
+    table->rows = malloc(row_capacity * sizeof(struct line_row));
+    table->files = malloc(file_capacity * sizeof(char*));
+    struct dwarf_cursor unit = { data, data + size };
+    while (unit.end - unit.p >= 4) {
+        unsigned int unit_length = read_uint(&unit, 4);
+        if (unit_length >= 0xfffffff0 || unit_length > (unsigned int)(unit.end - unit.p))
+            break;      // 64-bit DWARF or truncated
+        struct dwarf_cursor c = { unit.p, unit.p + unit_length };
+        unit.p += unit_length;
+        if (read_uint(&c, 2) != 5)
+            continue;
+        c.p += 2;       // address_size, segment_selector_size
+        unsigned int header_length = read_uint(&c, 4);
+        const unsigned char* program = c.p + header_length;
+        unsigned int min_insn_length = read_u8(&c);
+        read_u8(&c);    // maximum_operations_per_instruction
+        read_u8(&c);    // default_is_stmt
+        int line_base = (signed char)read_u8(&c);
+        unsigned int line_range = read_u8(&c);
+        unsigned int opcode_base = read_u8(&c);
+        unsigned char opcode_lengths[256] = {0};
+        for (unsigned int i = 1; i < opcode_base; i++)
+            opcode_lengths[i] = read_u8(&c);
+        if (line_range == 0)
+            continue;
+
+        // the directories, then the files (numbered from 0), each a list of
+        // entries described by (content type, form) pairs
+        int first_file = table->num_files;
+        const char* dirs[256] = {0};
+        for (int kind = 0; kind < 2; kind++) {     // 0: directories, 1: files
+            unsigned int formats[8][2];
+            unsigned int num_formats = read_u8(&c);
+            if (num_formats > 8) {
+                c.p = c.end;
+                break;
+            }
+            for (unsigned int f = 0; f < num_formats; f++) {
+                formats[f][0] = read_uleb(&c);  // content type
+                formats[f][1] = read_uleb(&c);  // form
+            }
+            unsigned int num_entries = read_uleb(&c);
+            for (unsigned int e = 0; e < num_entries && c.p < c.end; e++) {
+                const char* path = NULL;
+                unsigned int dir = 0;
+                for (unsigned int f = 0; f < num_formats; f++) {
+                    unsigned int value;
+                    const char* s = read_form(&c, formats[f][1], &value, line_str, line_str_size);
+                    if (formats[f][0] == 1)           // DW_LNCT_path
+                        path = s;
+                    else if (formats[f][0] == 2)      // DW_LNCT_directory_index
+                        dir = value;
+                }
+                if (kind == 0 && e < 256)
+                    dirs[e] = path;
+                else if (kind == 1)
+                    add_file(table, &file_capacity, dir < 256 ? dirs[dir] : NULL, path);
+            }
+        }
+        if (c.p != program)
+            continue;   // a form not read above
+        int num_unit_files = table->num_files - first_file;
+
+        // the line number state machine
+        c.p = program;
+        unsigned int address = 0, line = 1, file = 1;
+        while (c.p < c.end) {
+            unsigned int opcode = read_u8(&c);
+            int emit = 0, end_sequence = 0;
+            if (opcode >= opcode_base) {
+                unsigned int adjusted = opcode - opcode_base;
+                address += (adjusted / line_range) * min_insn_length;
+                line += line_base + (int)(adjusted % line_range);
+                emit = 1;
+            } else if (opcode == 0) {
+                unsigned int length = read_uleb(&c);
+                const unsigned char* next = c.p + length;
+                unsigned int sub_opcode = read_u8(&c);
+                if (sub_opcode == 1) {                  // DW_LNE_end_sequence
+                    emit = end_sequence = 1;
+                } else if (sub_opcode == 2) {           // DW_LNE_set_address
+                    address = read_uint(&c, length - 1);
+                }
+                c.p = next;
+            } else {
+                switch (opcode) {
+                    case 1: emit = 1; break;                                        // copy
+                    case 2: address += read_uleb(&c) * min_insn_length; break;      // advance_pc
+                    case 3: line += read_sleb(&c); break;                           // advance_line
+                    case 4: file = read_uleb(&c); break;                            // set_file
+                    case 8: address += ((255 - opcode_base) / line_range) * min_insn_length; break;
+                    case 9: address += read_uint(&c, 2); break;                     // fixed_advance_pc
+                    default:
+                        for (int i = 0; i < opcode_lengths[opcode]; i++)
+                            read_uleb(&c);
+                        break;
+                }
+            }
+            if (emit) {
+                int index = (int)file;
+                if (index < 0 || index >= num_unit_files)
+                    index = -first_file;    // unknown files map to the first file overall
+                add_row(table, &row_capacity, address, end_sequence ? 0 : line, first_file + index);
+            }
+            if (end_sequence) {
+                address = 0;
+                line = 1;
+                file = 1;
+            }
+        }
+    }
+    qsort(table->rows, table->num_rows, sizeof(struct line_row), compare_rows);
+}
+
+struct line_table* lines_read_from_elf(const char* file_name)
+{
+    FILE* file = fopen(file_name, "rb");
+    if (!file)
+        return NULL;
+    unsigned int size = 0, line_str_size = 0;
+    unsigned char* debug_line = read_section(file, ".debug_line", &size);
+    if (debug_line == NULL) {
+        fclose(file);
+        return NULL;
+    }
+    unsigned char* line_str = read_section(file, ".debug_line_str", &line_str_size);
+    fclose(file);
+
+    struct line_table* table = calloc(1, sizeof(struct line_table));
+    parse_debug_line(table, debug_line, size, line_str, line_str_size);
+    free(debug_line);
+    free(line_str);
+    if (table->num_files == 0) {
+        lines_delete(table);
+        return NULL;
+    }
+    return table;
+}
+
+void lines_delete(struct line_table* table)
+{
+    for (int i = 0; i < table->num_files; i++)
+        free(table->files[i]);
+    free(table->files);
+    free(table->rows);
+    free(table);
+}
+
+int lines_addr_to_line(struct line_table* table, unsigned int addr, const char** file, int* line)
+{
+    // binary search for the last row at or below addr
+    int lo = 0, hi = table->num_rows - 1, found = -1;
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        if (table->rows[mid].addr <= addr) {
+            found = mid;
+            lo = mid + 1;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    if (found < 0 || table->rows[found].line == 0)
+        return 0;
+    *file = table->files[table->rows[found].file];
+    *line = table->rows[found].line;
+    return 1;
+}
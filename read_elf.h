@@ -25,5 +25,23 @@ void symbols_delete(struct symbols* symbols);
 // map a value to a symbol (return NULL if no matching symbol found)
 const char* symbols_value_to_sym(struct symbols* symbols, unsigned int value);
 
+// map a symbol name to its value and size (return 0 if no such symbol)
+int symbols_sym_to_value(struct symbols* symbols, const char* name, unsigned int* value, unsigned int* size);
+
+// map an address to the function containing it (return NULL if none)
+// the start address of the function is stored in func_start, if non-NULL
+const char* symbols_addr_to_func(struct symbols* symbols, unsigned int addr, unsigned int* func_start);
+
+struct line_table;
+
+// read the source line table from the DWARF 5 .debug_line section (NULL if there is none)
+struct line_table* lines_read_from_elf(const char* file_name);
+
+// delete line table after use
+void lines_delete(struct line_table* table);
+
+// map an address to a source file and line (return 0 if unknown)
+int lines_addr_to_line(struct line_table* table, unsigned int addr, const char** file, int* line);
+
 
 #endif
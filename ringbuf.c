@@ -0,0 +1,61 @@
+#include "ringbuf.h"
+#include <stdlib.h>
+#include <string.h>
+
+void ringbuf_init(struct ringbuf* rb, size_t size)
+{
+    size_t rounded = 4096;
+    while (rounded < size)
+        rounded *= 2;
+    rb->data = malloc(rounded);
+    rb->size = rounded;
+    atomic_init(&rb->head, 0);
+    atomic_init(&rb->tail, 0);
+}
+
+void ringbuf_free(struct ringbuf* rb)
+{
+    free(rb->data);
+    rb->data = NULL;
+}
+
+size_t ringbuf_write(struct ringbuf* rb, const void* data, size_t len)
+{
+    size_t head = atomic_load_explicit(&rb->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&rb->tail, memory_order_acquire);
+    size_t space = rb->size - (head - tail);
+    if (len > space)
+        len = space;
+    size_t offset = head & (rb->size - 1);
+    size_t first = rb->size - offset;
+    if (first > len)
+        first = len;
+    memcpy(rb->data + offset, data, first);
+    memcpy(rb->data, (const unsigned char*)data + first, len - first);
+    atomic_store_explicit(&rb->head, head + len, memory_order_release);
+    return len;
+}
+
+size_t ringbuf_peek(struct ringbuf* rb, const void** data)
+{
+    size_t tail = atomic_load_explicit(&rb->tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&rb->head, memory_order_acquire);
+    size_t offset = tail & (rb->size - 1);
+    size_t len = head - tail;
+    if (len > rb->size - offset)
+        len = rb->size - offset;
+    *data = rb->data + offset;
+    return len;
+}
+
+void ringbuf_consume(struct ringbuf* rb, size_t len)
+{
+    size_t tail = atomic_load_explicit(&rb->tail, memory_order_relaxed);
+    atomic_store_explicit(&rb->tail, tail + len, memory_order_release);
+}
+
+size_t ringbuf_used(struct ringbuf* rb)
+{
+    return atomic_load_explicit(&rb->head, memory_order_acquire)
+         - atomic_load_explicit(&rb->tail, memory_order_acquire);
+}
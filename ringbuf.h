@@ -0,0 +1,30 @@
+#ifndef __RINGBUF_H__
+#define __RINGBUF_H__
+
+#include <stdatomic.h>
+#include <stddef.h>
+
+// Lock-free byte ring for exactly one producer thread and one consumer
+// thread. head is only written by the producer and tail only by the
+// consumer; each lives on its own cache line.
+struct ringbuf {
+    unsigned char* data;
+    size_t size;                    // power of two
+    _Alignas(64) atomic_size_t head;
+    _Alignas(64) atomic_size_t tail;
+};
+
+// size is rounded up to a power of two
+void ringbuf_init(struct ringbuf* rb, size_t size);
+void ringbuf_free(struct ringbuf* rb);
+
+// producer: copy up to len bytes in, returns how many fitted
+size_t ringbuf_write(struct ringbuf* rb, const void* data, size_t len);
+
+// consumer: get the contiguous readable bytes, then release them
+size_t ringbuf_peek(struct ringbuf* rb, const void** data);
+void ringbuf_consume(struct ringbuf* rb, size_t len);
+
+size_t ringbuf_used(struct ringbuf* rb);
+
+#endif
@@ -0,0 +1,158 @@
+#include "sampling.h"
+#include <limits.h>
+#include <stdlib.h>
+
+struct sample_point {
+    long interval;
+    double weight;
+    long insns;         // timed in the measured interval
+    long cycles;
+    int measuring;
+};
+
+struct sample_plan {
+    long interval_insns;
+    long warmup;
+    int num_points;
+    int current;        // the next point to warm up or measure
+    struct sample_point* points;
+};
+
+static int compare_points(const void* a, const void* b)
+{
+    const struct sample_point* pa = a;
+    const struct sample_point* pb = b;
+    return (pa->interval > pb->interval) - (pa->interval < pb->interval);
+}
+
+struct sample_plan* sample_plan_read(const char* file_name, long interval_insns, long warmup)
+{
+    FILE* f = fopen(file_name, "r");
+    if (!f)
+        return NULL;
+    struct sample_plan* sp = calloc(1, sizeof(struct sample_plan));
+    sp->interval_insns = interval_insns;
+    sp->warmup = warmup;
+    int cap = 0;
+    char line[256];
+    while (fgets(line, sizeof(line), f)) {
+        long interval;
+        double weight;
+        char* p = line;
+        while (*p == ' ' || *p == '\t')
+            p++;
+        if (*p == '#' || *p == '\n' || *p == 0)
+            continue;
+        if (sscanf(p, "%ld %lf", &interval, &weight) != 2 || interval < 0 || weight <= 0) {
+            fclose(f);
+            sample_plan_delete(sp);
+            return NULL;
+        }
+        if (sp->num_points == cap) {
+            cap = cap ? cap * 2 : 16;
+            sp->points = realloc(sp->points, cap * sizeof(struct sample_point));
+        }
+        struct sample_point* sample = &sp->points[sp->num_points++];
+        *sample = (struct sample_point){ .interval = interval, .weight = weight };
+    }
+    fclose(f);
+    if (sp->num_points == 0) {
+        sample_plan_delete(sp);
+        return NULL;
+    }
+    qsort(sp->points, sp->num_points, sizeof(struct sample_point), compare_points);
+    return sp;
+}
+
+void sample_plan_delete(struct sample_plan* sp)
+{
+    free(sp->points);
+    free(sp);
+}
+
+static void end_measure(struct sample_point* sample, struct pipeline* pipeline)
+{
+    const struct pipeline_stats* ps = pipeline_get_stats(pipeline);
+    sample->insns = ps->insns - sample->insns;
+    sample->cycles = ps->cycles - sample->cycles;
+    sample->measuring = 0;
+}
+
+int sample_plan_step(struct sample_plan* sp, long insns, struct pipeline* pipeline, long* next)
+{
+    while (sp->current < sp->num_points) {
+        struct sample_point* sample = &sp->points[sp->current];
+        long start = sample->interval * sp->interval_insns;
+        long end = start + sp->interval_insns;
+        if (sample->measuring) {
+            if (insns < end) {
+                *next = end;
+                return 1;
+            }
+            end_measure(sample, pipeline);
+            sp->current++;
+            continue;
+        }
+        if (insns >= start) {
+            // the counters as they are now, end_measure takes the difference
+            const struct pipeline_stats* ps = pipeline_get_stats(pipeline);
+            sample->insns = ps->insns;
+            sample->cycles = ps->cycles;
+            sample->measuring = 1;
+            *next = end;
+            return 1;
+        }
+        if (insns >= start - sp->warmup) {
+            *next = start;
+            return 1;
+        }
+        *next = start - sp->warmup;
+        return 0;
+    }
+    *next = LONG_MAX;
+    return 0;
+}
+
+void sample_plan_finish(struct sample_plan* sp, struct pipeline* pipeline)
+{
+    if (sp->current < sp->num_points && sp->points[sp->current].measuring) {
+        end_measure(&sp->points[sp->current], pipeline);
+        sp->current++;
+    }
+}
+
+static double estimated_cpi(struct sample_plan* sp)
+{
+    double sum = 0, weights = 0;
+    for (int i = 0; i < sp->num_points; i++) {
+        struct sample_point* sample = &sp->points[i];
+        if (sample->insns > 0) {
+            sum += sample->weight * sample->cycles / sample->insns;
+            weights += sample->weight;
+        }
+    }
+    return weights > 0 ? sum / weights : 0;
+}
+
+long sample_plan_cycles(struct sample_plan* sp, long insns)
+{
+    return (long)(estimated_cpi(sp) * insns + 0.5);
+}
+
+void sample_plan_write_report(struct sample_plan* sp, struct pipeline* pipeline, long insns, FILE* out)
+{
+    fprintf(out, "Sampled timing: %d simulation points of %ld instructions, warmup %ld\n",
+            sp->num_points, sp->interval_insns, sp->warmup);
+    fprintf(out, "%10s %8s %14s %14s %8s\n", "interval", "weight", "instructions", "cycles", "CPI");
+    for (int i = 0; i < sp->num_points; i++) {
+        struct sample_point* sample = &sp->points[i];
+        if (sample->insns > 0)
+            fprintf(out, "%10ld %8.4f %14ld %14ld %8.3f\n", sample->interval, sample->weight,
+                    sample->insns, sample->cycles, (double)sample->cycles / sample->insns);
+        else
+            fprintf(out, "%10ld %8.4f %14s\n", sample->interval, sample->weight, "not reached");
+    }
+    long timed = pipeline_get_stats(pipeline)->insns;
+    fprintf(out, "Estimated CPI: %.3f, %.2f%% of the instructions timed\n",
+            estimated_cpi(sp), insns ? 100.0 * timed / insns : 0.0);
+}
@@ -0,0 +1,33 @@
+#ifndef __SAMPLING_H__
+#define __SAMPLING_H__
+
+#include "pipeline.h"
+#include <stdio.h>
+
+// Sampled timing: the timing models are only fed during the chosen
+// intervals (simulation points, as picked by the simpoint tool from the
+// basic block vectors of sim -V), each preceded by a warmup that trains
+// caches and predictors without being measured. The rest of the run goes
+// at full speed with the models off. The CPI of the whole run is the
+// weighted mean of the CPI measured in each simulation point.
+struct sample_plan;
+
+// read "interval weight" lines ('#' starts a comment); interval numbers
+// count intervals of interval_insns instructions from 0. NULL on failure.
+struct sample_plan* sample_plan_read(const char* file_name, long interval_insns, long warmup);
+void sample_plan_delete(struct sample_plan* sp);
+
+// Called with the instruction count at block boundaries. Returns whether
+// the timing models are to be fed from now on and sets *next to the
+// instruction count at which that may change.
+int sample_plan_step(struct sample_plan* sp, long insns, struct pipeline* pipeline, long* next);
+
+// close a simulation point cut short by the end of the program
+void sample_plan_finish(struct sample_plan* sp, struct pipeline* pipeline);
+
+// the estimated cycles of a run of insns instructions
+long sample_plan_cycles(struct sample_plan* sp, long insns);
+
+void sample_plan_write_report(struct sample_plan* sp, struct pipeline* pipeline, long insns, FILE* out);
+
+#endif
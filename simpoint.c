@@ -0,0 +1,411 @@
+#include <float.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// simpoint: pick simulation points from the basic block vectors written by
+// 'sim riscv-elf -V bbv'. Each interval's vector is normalised, projected
+// down to a few dimensions and the intervals are clustered with k-means for
+// every k up to the maximum. The smallest k that scores close to the best
+// Bayesian information criterion is chosen, and the interval nearest to
+// each cluster centre becomes a simulation point, weighted by the share of
+// intervals in its cluster. 'sim riscv-elf -X points' times only those.
+
+#define DIMS 15             // dimensions of the random projection
+#define SEEDS 5             // k-means runs from different seeds for each k
+#define MAX_ITERATIONS 100
+#define BIC_THRESHOLD 0.9   // the chosen k scores at least this far from the worst to the best
+
+void terminate(const char *error)
+{
+  printf("%s\n", error);
+  printf("simpoint: Usage:\n");
+  printf("  simpoint [-k maxk] bbv [points]   // cluster the intervals in 'bbv' written by 'sim -V' into at most\n");
+  printf("                                    // 'maxk' clusters (default 10), write simulation points to 'points'\n");
+  printf("    'points' (default stdout) has a line 'interval weight' per simulation point, for 'sim -X'\n");
+  exit(-1);
+}
+
+// The projection matrix is too large to store for programs with many
+// blocks, so its entries are hashed from their position, uniform in [-1, 1)
+static double projection(long block, int dim)
+{
+  uint64_t x = (uint64_t)block * DIMS + dim + 0x9e3779b97f4a7c15ull;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+  x ^= x >> 31;
+  return (double)(x >> 11) / (1ull << 52) - 1.0;
+}
+
+// Read the vectors, each projected as it is read. Returns the number of intervals.
+static int read_vectors(FILE *in, double **vectors)
+{
+  int n = 0, cap = 0;
+  double *v = NULL;
+  char *line = NULL;
+  size_t line_cap = 0;
+  long *ids = NULL, *counts = NULL;
+  int pairs_cap = 0;
+  while (getline(&line, &line_cap, in) > 0)
+  {
+    if (line[0] != 'T')
+    {
+      continue;
+    }
+    int pairs = 0;
+    long total = 0;
+    char *p = line + 1;
+    long id, count;
+    int used;
+    while (sscanf(p, " :%ld:%ld%n", &id, &count, &used) == 2)
+    {
+      if (pairs == pairs_cap)
+      {
+        pairs_cap = pairs_cap ? pairs_cap * 2 : 256;
+        ids = realloc(ids, pairs_cap * sizeof(long));
+        counts = realloc(counts, pairs_cap * sizeof(long));
+      }
+      ids[pairs] = id;
+      counts[pairs++] = count;
+      total += count;
+      p += used;
+    }
+    if (total == 0)
+    {
+      continue;
+    }
+    if (n == cap)
+    {
+      cap = cap ? cap * 2 : 1024;
+      v = realloc(v, cap * DIMS * sizeof(double));
+    }
+    double *row = &v[n++ * DIMS];
+    for (int d = 0; d < DIMS; d++)
+    {
+      row[d] = 0;
+      for (int i = 0; i < pairs; i++)
+      {
+        row[d] += projection(ids[i], d) * counts[i] / total;
+      }
+    }
+  }
+  free(line);
+  free(ids);
+  free(counts);
+  *vectors = v;
+  return n;
+}
+
+static double distance2(const double *a, const double *b)
+{
+  double sum = 0;
+  for (int d = 0; d < DIMS; d++)
+  {
+    sum += (a[d] - b[d]) * (a[d] - b[d]);
+  }
+  return sum;
+}
+
+// Deterministic, so the same vectors always give the same points
+static uint64_t random_state;
+
+static double random_unit(void)
+{
+  random_state ^= random_state << 13;
+  random_state ^= random_state >> 7;
+  random_state ^= random_state << 17;
+  return (double)(random_state >> 11) / (1ull << 53);
+}
+
+struct clustering
+{
+  int k;
+  int *cluster;         // of each interval
+  double *centres;
+  double distortion;    // sum of squared distances to the centres
+  double bic;
+};
+
+// k-means++ seeding: each next centre is drawn with probability
+// proportional to the squared distance to the nearest centre so far
+static void seed_centres(const double *v, int n, int k, double *centres, double *nearest)
+{
+  int first = (int)(random_unit() * n);
+  memcpy(centres, &v[first * DIMS], DIMS * sizeof(double));
+  for (int i = 0; i < n; i++)
+  {
+    nearest[i] = distance2(&v[i * DIMS], centres);
+  }
+  for (int c = 1; c < k; c++)
+  {
+    double sum = 0;
+    for (int i = 0; i < n; i++)
+    {
+      sum += nearest[i];
+    }
+    double r = random_unit() * sum;
+    int pick = n - 1;
+    for (int i = 0; i < n; i++)
+    {
+      r -= nearest[i];
+      if (r < 0)
+      {
+        pick = i;
+        break;
+      }
+    }
+    double *centre = &centres[c * DIMS];
+    memcpy(centre, &v[pick * DIMS], DIMS * sizeof(double));
+    for (int i = 0; i < n; i++)
+    {
+      double d = distance2(&v[i * DIMS], centre);
+      if (d < nearest[i])
+      {
+        nearest[i] = d;
+      }
+    }
+  }
+}
+
+// Lloyd's iterations from the seeded centres, returns the distortion
+static double kmeans(const double *v, int n, int k, double *centres, int *cluster, int *sizes)
+{
+  double *sums = malloc(k * DIMS * sizeof(double));
+  for (int i = 0; i < n; i++)
+  {
+    cluster[i] = -1;
+  }
+  double distortion = 0;
+  for (int iteration = 0; iteration < MAX_ITERATIONS; iteration++)
+  {
+    int changed = 0;
+    distortion = 0;
+    for (int i = 0; i < n; i++)
+    {
+      int best = 0;
+      double best_d = DBL_MAX;
+      for (int c = 0; c < k; c++)
+      {
+        double d = distance2(&v[i * DIMS], &centres[c * DIMS]);
+        if (d < best_d)
+        {
+          best_d = d;
+          best = c;
+        }
+      }
+      changed |= cluster[i] != best;
+      cluster[i] = best;
+      distortion += best_d;
+    }
+    if (!changed)
+    {
+      break;
+    }
+    memset(sums, 0, k * DIMS * sizeof(double));
+    memset(sizes, 0, k * sizeof(int));
+    for (int i = 0; i < n; i++)
+    {
+      sizes[cluster[i]]++;
+      for (int d = 0; d < DIMS; d++)
+      {
+        sums[cluster[i] * DIMS + d] += v[i * DIMS + d];
+      }
+    }
+    for (int c = 0; c < k; c++)
+    {
+      // an emptied cluster keeps its centre
+      for (int d = 0; sizes[c] && d < DIMS; d++)
+      {
+        centres[c * DIMS + d] = sums[c * DIMS + d] / sizes[c];
+      }
+    }
+  }
+  free(sums);
+  memset(sizes, 0, k * sizeof(int));
+  for (int i = 0; i < n; i++)
+  {
+    sizes[cluster[i]]++;
+  }
+  return distortion;
+}
+
+// The Bayesian information criterion of X-means (Pelleg and Moore): the
+// log likelihood of the data under spherical Gaussians around the centres
+// with one shared variance, less a penalty for the number of parameters
+static double bic(int n, int k, const int *sizes, double distortion)
+{
+  if (n <= k)
+  {
+    return 0;
+  }
+  double variance = distortion / ((double)DIMS * (n - k));
+  if (variance < 1e-12)
+  {
+    variance = 1e-12;
+  }
+  double likelihood = -0.5 * DIMS * (n - k);
+  for (int c = 0; c < k; c++)
+  {
+    if (sizes[c])
+    {
+      likelihood += sizes[c] * log((double)sizes[c] / n) - 0.5 * sizes[c] * DIMS * log(2 * M_PI * variance);
+    }
+  }
+  int parameters = (k - 1) + k * DIMS + 1;
+  return likelihood - 0.5 * parameters * log(n);
+}
+
+// The best of SEEDS runs of k-means
+static void cluster_intervals(const double *v, int n, int k, struct clustering *result)
+{
+  double *centres = malloc(k * DIMS * sizeof(double));
+  double *nearest = malloc(n * sizeof(double));
+  int *cluster = malloc(n * sizeof(int));
+  int *sizes = malloc(k * sizeof(int));
+  result->k = k;
+  result->cluster = malloc(n * sizeof(int));
+  result->centres = malloc(k * DIMS * sizeof(double));
+  result->distortion = DBL_MAX;
+  for (int seed = 0; seed < SEEDS; seed++)
+  {
+    random_state = 0x5eed0000u + 1000 * k + seed;
+    seed_centres(v, n, k, centres, nearest);
+    double distortion = kmeans(v, n, k, centres, cluster, sizes);
+    if (distortion < result->distortion)
+    {
+      result->distortion = distortion;
+      result->bic = bic(n, k, sizes, distortion);
+      memcpy(result->cluster, cluster, n * sizeof(int));
+      memcpy(result->centres, centres, k * DIMS * sizeof(double));
+    }
+  }
+  free(centres);
+  free(nearest);
+  free(cluster);
+  free(sizes);
+}
+
+// Write the interval nearest to each cluster centre, in interval order
+static void write_points(const double *v, int n, const struct clustering *chosen, FILE *out)
+{
+  int k = chosen->k;
+  int *nearest = malloc(k * sizeof(int));
+  double *nearest_d = malloc(k * sizeof(double));
+  int *sizes = calloc(k, sizeof(int));
+  for (int c = 0; c < k; c++)
+  {
+    nearest[c] = -1;
+    nearest_d[c] = DBL_MAX;
+  }
+  for (int i = 0; i < n; i++)
+  {
+    int c = chosen->cluster[i];
+    double d = distance2(&v[i * DIMS], &chosen->centres[c * DIMS]);
+    sizes[c]++;
+    if (d < nearest_d[c])
+    {
+      nearest_d[c] = d;
+      nearest[c] = i;
+    }
+  }
+  fprintf(out, "# %d simulation points for %d intervals\n", k, n);
+  fprintf(out, "# interval weight\n");
+  for (int i = 0; i < n; i++)
+  {
+    for (int c = 0; c < k; c++)
+    {
+      if (nearest[c] == i)
+      {
+        fprintf(out, "%d %.6f\n", i, (double)sizes[c] / n);
+      }
+    }
+  }
+  free(nearest);
+  free(nearest_d);
+  free(sizes);
+}
+
+int main(int argc, char *argv[])
+{
+  int max_k = 10;
+  int first = 1;
+  if (argc > 2 && !strcmp(argv[1], "-k"))
+  {
+    max_k = atoi(argv[2]);
+    if (max_k <= 0)
+    {
+      terminate("Number of clusters must be positive");
+    }
+    first = 3;
+  }
+  if (argc != first + 1 && argc != first + 2)
+  {
+    terminate("Missing operands");
+  }
+  FILE *in = fopen(argv[first], "r");
+  if (in == NULL)
+  {
+    terminate("Could not open basic block vectors, terminating.");
+  }
+  double *v;
+  int n = read_vectors(in, &v);
+  fclose(in);
+  if (n == 0)
+  {
+    terminate("No intervals in basic block vectors, terminating.");
+  }
+  FILE *out = stdout;
+  if (argc == first + 2)
+  {
+    out = fopen(argv[first + 1], "w");
+    if (out == NULL)
+    {
+      terminate("Could not open file for simulation points, terminating.");
+    }
+  }
+  // the criterion needs more intervals than clusters
+  if (max_k >= n)
+  {
+    max_k = n > 1 ? n - 1 : 1;
+  }
+  struct clustering *runs = calloc(max_k, sizeof(struct clustering));
+  double low = DBL_MAX, high = -DBL_MAX;
+  for (int k = 1; k <= max_k; k++)
+  {
+    cluster_intervals(v, n, k, &runs[k - 1]);
+    if (runs[k - 1].bic < low)
+    {
+      low = runs[k - 1].bic;
+    }
+    if (runs[k - 1].bic > high)
+    {
+      high = runs[k - 1].bic;
+    }
+  }
+  int chosen = 0;
+  while (runs[chosen].bic < low + BIC_THRESHOLD * (high - low))
+  {
+    chosen++;
+  }
+  fprintf(stderr, "%4s %14s %14s\n", "k", "distortion", "BIC");
+  for (int k = 1; k <= max_k; k++)
+  {
+    fprintf(stderr, "%4d %14.6f %14.1f%s\n", k, runs[k - 1].distortion, runs[k - 1].bic,
+            k - 1 == chosen ? "  <- chosen" : "");
+  }
+  write_points(v, n, &runs[chosen], out);
+  if (out != stdout)
+  {
+    fclose(out);
+  }
+  for (int k = 0; k < max_k; k++)
+  {
+    free(runs[k].cluster);
+    free(runs[k].centres);
+  }
+  free(runs);
+  free(v);
+  return 0;
+}
@@ -0,0 +1,348 @@
+#include "trace.h"
+#include "btrace.h"
+#include "memory.h"
+#include "read_elf.h"
+#include "insnlog.h"
+#include "timing.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// simtrace: turn a binary trace written by 'sim riscv-elf -t trace' back
+// into the text format of 'sim riscv-elf -l log', rebuild the instruction
+// stream from a branch trace written by 'sim riscv-elf -B trace', or replay
+// a trace through many timing model configurations in parallel
+
+void terminate(const char *error)
+{
+  printf("%s\n", error);
+  printf("simtrace: Usage:\n");
+  printf("  simtrace trace [log]                // decode binary 'trace' to file 'log' (default stdout)\n");
+  printf("  simtrace -e riscv-elf trace [log]   // same, with symbols from 'riscv-elf' as in 'sim -l'\n");
+  printf("  simtrace -b riscv-elf trace [log]   // rebuild instructions from branch 'trace' of 'riscv-elf'\n");
+  printf("  simtrace -x configs trace [table]   // replay 'trace' through each configuration in file 'configs',\n");
+  printf("                                      // one thread each, and write a comparison table to 'table'\n");
+  printf("    a configuration is a line of sim options among -I cfg, -D cfg, -R models and -c cfg\n");
+  exit(-1);
+}
+
+// Decode a full trace
+void decode_trace(FILE *in, FILE *out, struct symbols *symbols)
+{
+  struct trace_reader *tr = trace_reader_open(in);
+  if (tr == NULL)
+  {
+    terminate("Not a trace file, terminating.");
+  }
+  struct insn_log *log = insn_log_create(out, symbols);
+  struct trace_record rec;
+  uint32_t regs[32];
+  uint32_t last_pc = 0;
+  long num_insns = 0;
+  memcpy(regs, trace_reader_regs(tr), sizeof(regs));
+  while (trace_read(tr, &rec))
+  {
+    if (rec.end)
+    {
+      if (rec.reason == TRACE_UNHANDLED)
+      {
+        insn_log_plain(log, ++num_insns, rec.pc, rec.insn);
+        fprintf(out, "Unhandled instruction\n");
+      }
+      else
+      {
+        fprintf(out, "Program terminated at %08x\n", last_pc);
+      }
+      break;
+    }
+    // regs holds the registers before the instruction
+    insn_log_before(log, rec.pc, rec.insn, regs);
+    memcpy(regs, trace_reader_regs(tr), sizeof(regs));
+    insn_log_after(log, ++num_insns, regs);
+    last_pc = rec.pc;
+  }
+  insn_log_delete(log);
+  trace_reader_close(tr);
+}
+
+// Rebuild the instruction stream from a branch trace and the program.
+// Register values are not in a branch trace, so lines have no effects.
+void reconstruct_branch_trace(const char *elf_name, struct symbols *symbols, FILE *in, FILE *out)
+{
+  struct memory *mem = memory_create();
+  struct program_info prog_info;
+  if (read_elf(mem, &prog_info, elf_name, stderr))
+  {
+    terminate("Could not read program, terminating.");
+  }
+  struct btrace_reader *br = btrace_reader_open(in, mem);
+  if (br == NULL)
+  {
+    terminate("Not a branch trace file, terminating.");
+  }
+  struct insn_log *log = insn_log_create(out, symbols);
+  uint32_t pc = 0, insn;
+  long num_insns = 0;
+  while (btrace_next(br, &pc, &insn))
+  {
+    insn_log_plain(log, ++num_insns, pc, insn);
+  }
+  if (btrace_end_reason(br) == TRACE_EXIT)
+    fprintf(out, "Program terminated at %08x\n", pc);
+  else if (btrace_end_reason(br) == TRACE_UNHANDLED)
+    fprintf(out, "Unhandled instruction\n");
+  else
+    fprintf(stderr, "simtrace: branch trace ends early, after %ld instructions\n", num_insns);
+  insn_log_delete(log);
+  btrace_reader_close(br);
+  memory_delete(mem);
+}
+
+// One line of the configurations file and the models it sets up
+struct replay_config
+{
+  char text[256];
+  struct timing_models models;
+  long insns;
+  const char *trace_name;
+  pthread_t thread;
+  int failed;
+};
+
+// Set up the models from options like those of sim, returns 0 if valid
+int parse_replay_config(char *line, struct replay_config *rc)
+{
+  memset(&rc->models, 0, sizeof(rc->models));
+  char *save;
+  for (char *opt = strtok_r(line, " \t\n", &save); opt; opt = strtok_r(NULL, " \t\n", &save))
+  {
+    char *arg = strtok_r(NULL, " \t\n", &save);
+    if (arg == NULL)
+    {
+      return -1;
+    }
+    struct cache_config cache_config;
+    struct pipeline_config pipeline_config;
+    if (!strcmp(opt, "-I") && !rc->models.icache && !cache_parse_config(arg, &cache_config))
+      rc->models.icache = cache_create(&cache_config);
+    else if (!strcmp(opt, "-D") && !rc->models.dcache && !cache_parse_config(arg, &cache_config))
+      rc->models.dcache = cache_create(&cache_config);
+    else if (!strcmp(opt, "-R") && !rc->models.bpred && (rc->models.bpred = bpred_create(arg)) != NULL)
+      continue;
+    else if (!strcmp(opt, "-c") && !rc->models.pipeline && !pipeline_parse_config(arg, &pipeline_config))
+      rc->models.pipeline = pipeline_create(&pipeline_config);
+    else
+      return -1;
+  }
+  return 0;
+}
+
+// Feed the whole trace to the models of one configuration
+void *replay_thread(void *arg)
+{
+  struct replay_config *rc = arg;
+  FILE *in = fopen(rc->trace_name, "rb");
+  struct trace_reader *tr = in ? trace_reader_open(in) : NULL;
+  if (tr == NULL)
+  {
+    rc->failed = 1;
+    if (in)
+    {
+      fclose(in);
+    }
+    return NULL;
+  }
+  // an instruction goes to the models once the pc after it is known
+  struct trace_record cur, next;
+  int have = trace_read(tr, &cur) && !cur.end;
+  while (have)
+  {
+    int more = trace_read(tr, &next) && !next.end;
+    uint32_t next_pc = more ? next.pc : cur.pc + 4;
+    timing_insn(&rc->models, cur.pc, cur.insn, next_pc, cur.mem ? cur.mem_addr : 0);
+    rc->insns++;
+    cur = next;
+    have = more;
+  }
+  trace_reader_close(tr);
+  fclose(in);
+  return NULL;
+}
+
+// A rate, or "-" when the configuration has no model for it
+void write_percent(FILE *out, int present, long part, long total)
+{
+  if (present)
+    fprintf(out, " %8.2f%%", total ? 100.0 * part / total : 0.0);
+  else
+    fprintf(out, " %9s", "-");
+}
+
+// Replay the trace through every configuration in parallel and compare them
+void replay_configs(const char *configs_name, const char *trace_name, FILE *out)
+{
+  FILE *configs = fopen(configs_name, "r");
+  if (configs == NULL)
+  {
+    terminate("Could not open configurations, terminating.");
+  }
+  int num = 0, cap = 16;
+  struct replay_config *rcs = malloc(cap * sizeof(struct replay_config));
+  char line[256];
+  while (fgets(line, sizeof(line), configs))
+  {
+    int len = strcspn(line, "#\n");
+    while (len > 0 && (line[len - 1] == ' ' || line[len - 1] == '\t'))
+    {
+      len--;
+    }
+    line[len] = '\0';
+    if (strspn(line, " \t") == (size_t)len)
+    {
+      continue;
+    }
+    if (num == cap)
+    {
+      cap *= 2;
+      rcs = realloc(rcs, cap * sizeof(struct replay_config));
+    }
+    struct replay_config *rc = &rcs[num];
+    memset(rc, 0, sizeof(*rc));
+    strcpy(rc->text, line + strspn(line, " \t"));
+    rc->trace_name = trace_name;
+    if (parse_replay_config(line, rc))
+    {
+      fprintf(stderr, "simtrace: invalid configuration: %s\n", rc->text);
+      terminate("Invalid configuration, terminating.");
+    }
+    num++;
+  }
+  fclose(configs);
+
+  for (int i = 0; i < num; i++)
+  {
+    if (pthread_create(&rcs[i].thread, NULL, replay_thread, &rcs[i]))
+    {
+      terminate("Could not start replay thread, terminating.");
+    }
+  }
+  for (int i = 0; i < num; i++)
+  {
+    pthread_join(rcs[i].thread, NULL);
+    if (rcs[i].failed)
+    {
+      terminate("Not a trace file, terminating.");
+    }
+  }
+
+  fprintf(out, "%3s %12s %12s %8s %9s %9s %9s %9s  %s\n", "#", "instructions", "cycles", "CPI",
+          "I-miss", "D-miss", "br-miss", "ret-miss", "configuration");
+  for (int i = 0; i < num; i++)
+  {
+    struct replay_config *rc = &rcs[i];
+    struct timing_models *m = &rc->models;
+    fprintf(out, "%3d %12ld", i + 1, rc->insns);
+    if (m->pipeline)
+    {
+      long cycles = pipeline_cycles(m->pipeline);
+      fprintf(out, " %12ld %8.3f", cycles, rc->insns ? (double)cycles / rc->insns : 0.0);
+    }
+    else
+    {
+      fprintf(out, " %12s %8s", "-", "-");
+    }
+    const struct cache_stats *is = m->icache ? cache_get_stats(m->icache) : NULL;
+    const struct cache_stats *ds = m->dcache ? cache_get_stats(m->dcache) : NULL;
+    write_percent(out, is != NULL, is ? is->read_misses : 0, is ? is->reads : 0);
+    write_percent(out, ds != NULL, ds ? ds->read_misses + ds->write_misses : 0, ds ? ds->reads + ds->writes : 0);
+    struct bpred_stats bs = { 0, 0, 0, 0, 0, 0 };
+    if (m->bpred)
+    {
+      bpred_get_stats(m->bpred, &bs);
+    }
+    write_percent(out, bs.has_direction, bs.mispredicts, bs.branches);
+    write_percent(out, bs.has_ras, bs.ras_misses, bs.returns);
+    fprintf(out, "  %s\n", rc->text);
+
+    if (m->icache)
+      cache_delete(m->icache);
+    if (m->dcache)
+      cache_delete(m->dcache);
+    if (m->bpred)
+      bpred_delete(m->bpred);
+    if (m->pipeline)
+      pipeline_delete(m->pipeline);
+  }
+  free(rcs);
+}
+
+int main(int argc, char *argv[])
+{
+  if (argc > 1 && !strcmp(argv[1], "-x"))
+  {
+    if (argc != 4 && argc != 5)
+    {
+      terminate("Missing operands");
+    }
+    FILE *out = stdout;
+    if (argc == 5)
+    {
+      out = fopen(argv[4], "w");
+      if (out == NULL)
+      {
+        terminate("Could not open file for table, terminating.");
+      }
+    }
+    replay_configs(argv[2], argv[3], out);
+    if (out != stdout)
+    {
+      fclose(out);
+    }
+    return 0;
+  }
+  int branch_trace = argc > 1 && !strcmp(argv[1], "-b");
+  int with_elf = branch_trace || (argc > 1 && !strcmp(argv[1], "-e"));
+  int first = with_elf ? 3 : 1;
+  if (argc != first + 1 && argc != first + 2)
+  {
+    terminate("Missing operands");
+  }
+  FILE *in = fopen(argv[first], "rb");
+  if (in == NULL)
+  {
+    terminate("Could not open trace, terminating.");
+  }
+  FILE *out = stdout;
+  if (argc == first + 2)
+  {
+    out = fopen(argv[first + 1], "w");
+    if (out == NULL)
+    {
+      terminate("Could not open logfile, terminating.");
+    }
+  }
+  struct symbols *symbols = NULL;
+  if (with_elf)
+  {
+    symbols = symbols_read_from_elf(argv[2]);
+    if (symbols == NULL)
+    {
+      terminate("Could not read symbols, terminating.");
+    }
+  }
+  if (branch_trace)
+    reconstruct_branch_trace(argv[2], symbols, in, out);
+  else
+    decode_trace(in, out, symbols);
+  if (symbols)
+  {
+    symbols_delete(symbols);
+  }
+  fclose(in);
+  if (out != stdout)
+  {
+    fclose(out);
+  }
+  return 0;
+}
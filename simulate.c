@@ -3,8 +3,14 @@
 #include "read_elf.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <stdint.h>
+#include <limits.h>
+#include <signal.h>
 #include "helper.h"
+#include "insnlog.h"
+#include "console.h"
+#include "files.h"
 #include <stdbool.h>
 
 // Basic CPU state
@@ -20,12 +26,286 @@ static inline uint32_t get_field(uint32_t insn, int start, int len) {
     return (insn >> start) & ((1 << len) - 1);
 }
 
-struct Stat simulate(struct memory *mem, int start_addr, FILE *log_file, struct symbols* symbols) {
-    (void)symbols;  // Mark parameter as intentionally unused
+// Periodic work is only looked at on basic block boundaries (branches and jumps).
+// The loop compares the instruction count against the earliest due event, so
+// nothing is paid per instruction and a single compare per block while idle.
+// Signal handlers force a check by calling simulate_interrupt().
+static volatile long next_event;
+static volatile sig_atomic_t interrupted;
+static long next_sample;
+static uint32_t block_start;
+
+// The timing models are fed while timing_on is set, which a sample plan
+// switches on only around its simulation points
+static int timing_on;
+static long next_plan_step;
+
+// Set at the block boundary where the checkpoint is due. It is written
+// after the instruction, when the state is complete.
+static int checkpoint_due;
+
+// The -l log is written while 'logging' is set. Until the log window opens
+// the log waits in 'log_waiting', and only the block event check runs.
+static struct insn_log *logging;
+static struct insn_log *log_waiting;
+static long log_left;
+static uint32_t log_func_start, log_func_size;
+
+// Flight recorder: the last instructions executed are always kept, so a
+// failure can be looked at without a rerun with -l. It is written at the
+// end of every instruction, without tests, and only read when dumped.
+#define FLIGHT_RECORDER_SIZE 64     // power of two
+struct flight_record {
+    uint32_t pc;
+    uint32_t insn;
+    uint32_t rd_value;  // value of the register in the rd field afterwards
+};
+static struct flight_record flight_recorder[FLIGHT_RECORDER_SIZE];
+static volatile sig_atomic_t dump_requested;
+static struct symbols *sim_symbols;
+
+// The memory mapped console ring is only there when asked for (-O). It is
+// emptied this often, and before every ecall.
+#define CONSOLE_DRAIN_INTERVAL 4096
+static struct memory *sim_mem;
+static int console_ring;
+static long next_drain;
+
+static void drain_console_ring(void) {
+    if (console_ring) console_drain_ring(sim_mem);
+}
+
+static void sigusr1_handler(int sig) {
+    (void)sig;
+    dump_requested = 1;
+    simulate_interrupt();
+}
+
+// Write the recorded instructions up to and including number last
+static void flight_recorder_dump(FILE *out, long last) {
+    long first = last - FLIGHT_RECORDER_SIZE + 1;
+    if (first < 1) first = 1;
+    fprintf(out, "Last %ld instructions executed:\n", last - first + 1);
+    struct insn_log *log = insn_log_create(out, sim_symbols);
+    for (long n = first; n <= last; n++) {
+        struct flight_record *rec = &flight_recorder[n & (FLIGHT_RECORDER_SIZE - 1)];
+        insn_log_result(log, n, rec->pc, rec->insn, rec->rd_value);
+    }
+    insn_log_delete(log);
+    fflush(out);
+}
+
+void simulate_interrupt(void) {
+    interrupted = 1;
+    next_event = 0;
+}
+
+// Open the log window if it is due. Returns when to look again.
+static long check_log_window(struct log_window *w, long insns, uint32_t next_pc) {
+    if (insns < w->start_insn) return w->start_insn;
+    // waiting for a start pc means looking at every block
+    if (w->has_start_pc && next_pc != w->start_pc) return 0;
+    logging = log_waiting;
+    log_waiting = NULL;
+    log_left = w->max_insns;
+    return LONG_MAX;
+}
+
+static long block_events(struct Stat *stats, struct sim_options *opts, uint32_t pc, uint32_t next_pc) {
+    long next = LONG_MAX;
+    interrupted = 0;
+    if (dump_requested) {
+        // the instruction at pc is not recorded yet
+        dump_requested = 0;
+        drain_console_ring();
+        console_flush();
+        flight_recorder_dump(stderr, stats->insns - 1);
+    }
+    if (opts->blocks || opts->bbv) {
+        // counting blocks needs a look at every block
+        if (opts->blocks) block_counts_record(opts->blocks, block_start, pc);
+        if (opts->bbv) bbv_block(opts->bbv, block_start, pc, stats->insns);
+        block_start = next_pc;
+        next = 0;
+    }
+    if (opts->sample_plan) {
+        if (stats->insns >= next_plan_step)
+            timing_on = sample_plan_step(opts->sample_plan, stats->insns, opts->pipeline, &next_plan_step);
+        if (next_plan_step < next) next = next_plan_step;
+    }
+    if (opts->callstack && opts->sample_interval > 0) {
+        if (stats->insns >= next_sample) {
+            callstack_sample(opts->callstack);
+            next_sample = stats->insns + opts->sample_interval;
+        }
+        if (next_sample < next) next = next_sample;
+    }
+    if (opts->profile) profile_poll(opts->profile, pc);
+    if (stats->insns >= next_drain) {
+        console_drain_ring(sim_mem);
+        next_drain = stats->insns + CONSOLE_DRAIN_INTERVAL;
+    }
+    if (next_drain < next) next = next_drain;
+    if (log_waiting) {
+        long at = check_log_window(opts->log_window, stats->insns, next_pc);
+        if (at < next) next = at;
+    }
+    if (opts->checkpoint && !checkpoint_due) {
+        struct checkpoint_request *c = opts->checkpoint;
+        if (stats->insns < c->at_insn) {
+            if (c->at_insn < next) next = c->at_insn;
+        } else if (!c->has_pc || next_pc == c->at_pc) {
+            checkpoint_due = 1;
+        } else {
+            next = 0;
+        }
+    }
+    // don't lose an interrupt which arrived while we were busy
+    return interrupted ? 0 : next;
+}
+
+// Record the block the program stopped in. A checkpoint stops at a block
+// boundary, block_events has recorded the last block then.
+static void finish_blocks(struct sim_options *opts, int in_block) {
+    if (opts->blocks && in_block) block_counts_finish(opts->blocks, block_start, cpu.pc);
+    if (opts->bbv) {
+        if (in_block) bbv_finish(opts->bbv, block_start, cpu.pc);
+        else bbv_flush(opts->bbv);
+    }
+}
+
+// Let a timing thread catch up, and take the cycle count from the pipeline,
+// or estimate it from the simulation points of a sample plan
+#define TIMING_RING_SIZE (1 << 20)
+static void finish_timing(struct Stat *stats, struct sim_options *opts, struct timing_thread *timing) {
+    if (timing) timing_thread_stop(timing);
+    if (opts->sample_plan) {
+        // the cycles of this run, after those of a checkpoint
+        long first = opts->restore ? checkpoint_get_state(opts->restore)->insns : 0;
+        sample_plan_finish(opts->sample_plan, opts->pipeline);
+        stats->cycles = sample_plan_cycles(opts->sample_plan, stats->insns - first);
+    } else if (opts->pipeline) {
+        stats->cycles = pipeline_cycles(opts->pipeline);
+    }
+}
+
+// Copy a zero terminated string from guest memory (truncated to fit)
+static void read_guest_string(struct memory *mem, uint32_t addr, char *buf, int size) {
+    int i = 0;
+    while (i < size - 1 && (buf[i] = memory_rd_b(mem, addr + i)) != 0) i++;
+    buf[i] = 0;
+}
+
+// open_file(path, mode) ecall
+static int32_t sys_open(struct memory *mem, struct file_table *files, uint32_t path_addr, uint32_t mode_addr) {
+    char path[4096], mode[8];
+    read_guest_string(mem, path_addr, path, sizeof(path));
+    read_guest_string(mem, mode_addr, mode, sizeof(mode));
+    return file_table_open(files, path, mode);
+}
+
+// mmap(addr, length, prot, flags, fd, offset) ecall: the file is mapped
+// copy-on-write whatever prot and flags say. Without an address, mappings
+// are placed upwards from MMAP_BASE, well clear of stack and heap.
+#define MMAP_BASE 0x40000000
+static uint32_t next_mmap_addr;
+
+static uint32_t sys_mmap(struct memory *mem, struct file_table *files, uint32_t addr, uint32_t length,
+                         int fd, uint32_t offset) {
+    int host_fd = file_table_host_fd(files, fd);
+    if (host_fd < 0) return -1;
+    if (addr == 0) addr = next_mmap_addr;
+    if (memory_map_file(mem, addr, length, host_fd, offset)) return -1;
+    file_table_add_mapping(files, fd, addr, length, offset);
+    uint32_t end = (addr + length + 0xffff) & ~0xffffu;
+    if (end > next_mmap_addr) next_mmap_addr = end;
+    return addr;
+}
+
+// Save the machine as it is between two instructions
+static void write_checkpoint(struct Stat *stats, struct checkpoint_request *c, struct memory *mem,
+                             struct file_table *files) {
+    // the console ring is empty in the checkpoint
+    drain_console_ring();
+    console_flush();
+    struct checkpoint_state state;
+    state.pc = cpu.pc;
+    memcpy(state.regs, cpu.regs, sizeof(state.regs));
+    state.insns = stats->insns;
+    state.branches = stats->branches;
+    state.taken_branches = stats->taken_branches;
+    state.next_mmap_addr = next_mmap_addr;
+    c->written = checkpoint_write(c->out, &state, mem, files) ? -1 : 1;
+}
+
+struct Stat simulate(struct memory *mem, int start_addr, FILE *log_file, struct symbols* symbols,
+                     struct sim_options *opts) {
     struct Stat stats = {0};
+    struct sim_options no_opts = {0};
+    if (opts == NULL) opts = &no_opts;
     cpu.pc = start_addr;
     cpu.regs[0] = 0; // x0 is hardwired to 0
 
+    struct callstack *callstack = opts->callstack;
+    struct branch_stats *branch_stats = opts->branch_stats;
+    struct trace_writer *trace = opts->trace;
+    struct btrace_writer *btrace = opts->btrace;
+    struct timeline *timeline = opts->timeline;
+    struct timing_models models = { opts->icache, opts->dcache, opts->stack_dist, opts->bpred, opts->pipeline };
+    int timed = models.icache || models.dcache || models.stack_dist || models.bpred || models.pipeline;
+    // a sample plan reads the pipeline counters as it goes, so it needs the models inline
+    struct timing_thread *timing = timed && opts->timing_thread && !opts->sample_plan
+                                   ? timing_thread_start(&models, TIMING_RING_SIZE) : NULL;
+    struct file_table *files = file_table_create();
+    next_mmap_addr = MMAP_BASE;
+    if (opts->restore) {
+        // main has put the pages back, the rest of the machine goes here
+        const struct checkpoint_state *state = checkpoint_get_state(opts->restore);
+        memcpy(cpu.regs, state->regs, sizeof(cpu.regs));
+        cpu.regs[0] = 0;
+        stats.insns = state->insns;
+        stats.branches = state->branches;
+        stats.taken_branches = state->taken_branches;
+        next_mmap_addr = state->next_mmap_addr;
+        if (checkpoint_resume_io(opts->restore, files))
+            printf("Warning: could not open or map all files of the checkpoint again\n");
+    }
+    checkpoint_due = 0;
+    struct insn_log *log_owner = log_file ? insn_log_create(log_file, symbols) : NULL;
+    struct log_window *window = opts->log_window;
+    logging = log_owner;
+    log_waiting = NULL;
+    log_left = 0;
+    log_func_start = 0;
+    log_func_size = UINT32_MAX;
+    if (log_owner && window) {
+        logging = NULL;
+        log_waiting = log_owner;
+        log_func_start = window->func_start;
+        log_func_size = window->func_end - window->func_start;
+        check_log_window(window, stats.insns, start_addr);
+    }
+    if (trace) trace_begin(trace, cpu.pc, cpu.regs);
+    sim_symbols = symbols;
+    dump_requested = 0;
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = sigusr1_handler;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGUSR1, &action, NULL);
+
+    next_sample = stats.insns + opts->sample_interval;
+    block_start = start_addr;
+    sim_mem = mem;
+    console_ring = opts->console_ring;
+    next_drain = console_ring ? stats.insns + CONSOLE_DRAIN_INTERVAL : LONG_MAX;
+    // the first block boundary works out when each event is due
+    next_event = 0;
+    timing_on = timed;
+    if (opts->sample_plan)
+        timing_on = sample_plan_step(opts->sample_plan, stats.insns, opts->pipeline, &next_plan_step);
+
     printf("Simulation started at address 0x%x\n", start_addr);
 
     while (1) {
@@ -34,11 +314,12 @@ struct Stat simulate(struct memory *mem, int start_addr, FILE *log_file, struct
         
         // Fetch instruction
         uint32_t insn = memory_rd_w(mem, cpu.pc);
+        const uint32_t pc = cpu.pc;
         stats.insns++;
+        uint32_t mem_addr = 0;  // of a load or store, for the timing models
 
-        if (log_file) {
-            fprintf(log_file, "%8ld     %08x : %08x     ", stats.insns, cpu.pc, insn);
-        }
+        struct insn_log *log = logging && pc - log_func_start < log_func_size ? logging : NULL;
+        if (log) insn_log_before(log, pc, insn, cpu.regs);
 
         // Get opcode (bits 0-6)
         uint32_t opcode = insn & 0x7F;
@@ -64,6 +345,22 @@ struct Stat simulate(struct memory *mem, int start_addr, FILE *log_file, struct
                             case 7: cpu.regs[rd] = cpu.regs[rs1] & cpu.regs[rs2]; break; // and
                         }
                         break;
+                    case 1: { // M extension
+                        uint32_t a = cpu.regs[rs1], b = cpu.regs[rs2];
+                        // division by zero and INT_MIN / -1 don't trap, they give fixed results
+                        int overflow = a == 0x80000000u && b == 0xffffffffu;
+                        switch (funct3) {
+                            case 0: cpu.regs[rd] = a * b; break; // mul
+                            case 1: cpu.regs[rd] = ((int64_t)(int32_t)a * (int32_t)b) >> 32; break; // mulh
+                            case 2: cpu.regs[rd] = ((int64_t)(int32_t)a * (uint64_t)b) >> 32; break; // mulhsu
+                            case 3: cpu.regs[rd] = ((uint64_t)a * b) >> 32; break; // mulhu
+                            case 4: cpu.regs[rd] = b == 0 ? 0xffffffffu : overflow ? a : (uint32_t)((int32_t)a / (int32_t)b); break; // div
+                            case 5: cpu.regs[rd] = b == 0 ? 0xffffffffu : a / b; break; // divu
+                            case 6: cpu.regs[rd] = b == 0 ? a : overflow ? 0 : (uint32_t)((int32_t)a % (int32_t)b); break; // rem
+                            case 7: cpu.regs[rd] = b == 0 ? a : a % b; break; // remu
+                        }
+                        break;
+                    }
                     case 32:
                         switch (funct3) {
                             case 0: cpu.regs[rd] = cpu.regs[rs1] - cpu.regs[rs2]; break; // sub
@@ -82,6 +379,11 @@ struct Stat simulate(struct memory *mem, int start_addr, FILE *log_file, struct
 
                 switch (funct3) {
                     case 0: cpu.regs[rd] = cpu.regs[rs1] + imm; break; // addi
+                    case 1: cpu.regs[rd] = cpu.regs[rs1] << (imm & 0x1F); break; // slli
+                    case 5: // srli, srai
+                        if (imm & 0x400) cpu.regs[rd] = (int32_t)cpu.regs[rs1] >> (imm & 0x1F);
+                        else cpu.regs[rd] = cpu.regs[rs1] >> (imm & 0x1F);
+                        break;
                     case 2: cpu.regs[rd] = (int32_t)cpu.regs[rs1] < imm; break; // slti
                     case 3: cpu.regs[rd] = cpu.regs[rs1] < (uint32_t)imm; break; // sltiu
                     case 4: cpu.regs[rd] = cpu.regs[rs1] ^ imm; break; // xori
@@ -97,6 +399,7 @@ struct Stat simulate(struct memory *mem, int start_addr, FILE *log_file, struct
                 int imm = sign_extend(get_field(insn, 20, 12), 12);
                 int funct3 = get_field(insn, 12, 3);
                 uint32_t addr = cpu.regs[rs1] + imm;
+                mem_addr = addr;
 
                 switch (funct3) {
                     case 0: cpu.regs[rd] = sign_extend(memory_rd_b(mem, addr), 8); break; // lb
@@ -115,6 +418,7 @@ struct Stat simulate(struct memory *mem, int start_addr, FILE *log_file, struct
                                      get_field(insn, 7, 5), 12);
                 int funct3 = get_field(insn, 12, 3);
                 uint32_t addr = cpu.regs[rs1] + imm;
+                mem_addr = addr;
 
                 switch (funct3) {
                     case 0: memory_wr_b(mem, addr, cpu.regs[rs2]); break; // sb
@@ -143,6 +447,12 @@ struct Stat simulate(struct memory *mem, int start_addr, FILE *log_file, struct
                     case 7: take_branch = (cpu.regs[rs1] >= cpu.regs[rs2]); break; // bgeu
                 }
 
+                stats.branches++;
+                if (take_branch) stats.taken_branches++;
+                if (branch_stats) branch_stats_record(branch_stats, cpu.pc, imm < 0, take_branch);
+                if (btrace) btrace_branch(btrace, take_branch);
+                if (stats.insns >= next_event)
+                    next_event = block_events(&stats, opts, cpu.pc, take_branch ? cpu.pc + imm : cpu.pc + 4);
                 if (take_branch) {
                     cpu.pc += imm - 4;  // -4 because we add 4 at the end of the loop
                 }
@@ -156,6 +466,10 @@ struct Stat simulate(struct memory *mem, int start_addr, FILE *log_file, struct
                                     (get_field(insn, 20, 1) << 11) |
                                     (get_field(insn, 21, 10) << 1), 21);
                 
+                if (callstack && rd == 1) callstack_call(callstack, cpu.pc + imm, cpu.pc + 4);
+                if (timeline && rd == 1) timeline_call(timeline, stats.insns, cpu.pc + imm, cpu.pc + 4);
+                if (btrace) btrace_jal(btrace, cpu.pc, rd);
+                if (stats.insns >= next_event) next_event = block_events(&stats, opts, cpu.pc, cpu.pc + imm);
                 cpu.regs[rd] = cpu.pc + 4;
                 cpu.pc += imm - 4;  // -4 because we add 4 at the end of the loop
                 break;
@@ -167,6 +481,16 @@ struct Stat simulate(struct memory *mem, int start_addr, FILE *log_file, struct
                 int imm = sign_extend(get_field(insn, 20, 12), 12);
                 
                 uint32_t next_pc = (cpu.regs[rs1] + imm) & ~1;  // Clear least significant bit
+                if (callstack) {
+                    if (rd == 1) callstack_call(callstack, next_pc, cpu.pc + 4);
+                    else if (rd == 0 && rs1 == 1) callstack_return(callstack, next_pc);
+                }
+                if (timeline) {
+                    if (rd == 1) timeline_call(timeline, stats.insns, next_pc, cpu.pc + 4);
+                    else if (rd == 0 && rs1 == 1) timeline_return(timeline, stats.insns, next_pc);
+                }
+                if (btrace) btrace_jalr(btrace, cpu.pc, rd, next_pc);
+                if (stats.insns >= next_event) next_event = block_events(&stats, opts, cpu.pc, next_pc);
                 cpu.regs[rd] = cpu.pc + 4;
                 cpu.pc = next_pc - 4;  // -4 because we add 4 at the end of the loop
                 break;
@@ -174,19 +498,58 @@ struct Stat simulate(struct memory *mem, int start_addr, FILE *log_file, struct
 
             case 0x73: { // ECALL
                 if (get_field(insn, 12, 3) == 0) {  // ECALL
+                    drain_console_ring();
                     switch (cpu.regs[17]) {  // a7 holds syscall number
                         case 1:  // getchar
-                            cpu.regs[10] = getchar();
+                            cpu.regs[10] = console_getchar();
                             break;
                         case 2:  // putchar
-                            putchar(cpu.regs[10]);
-                            fflush(stdout);  // Ensure immediate output
+                            console_putchar(cpu.regs[10]);
+                            break;
+                        case 4: { // read_int_buffer(file, buffer, max_size) - sizes count words
+                            int32_t n = file_table_read(files, mem, cpu.regs[10], cpu.regs[11], cpu.regs[12] * 4);
+                            cpu.regs[10] = n < 0 ? n : n / 4;
+                            break;
+                        }
+                        case 5: { // write_int_buffer(file, buffer, size)
+                            int32_t n = file_table_write(files, mem, cpu.regs[10], cpu.regs[11], cpu.regs[12] * 4);
+                            cpu.regs[10] = n < 0 ? n : n / 4;
+                            break;
+                        }
+                        case 6:  // open_file(path, mode)
+                            cpu.regs[10] = sys_open(mem, files, cpu.regs[10], cpu.regs[11]);
+                            break;
+                        case 7:  // close_file(file)
+                            cpu.regs[10] = file_table_close(files, cpu.regs[10]);
+                            break;
+                        case 63: // read(fd, buf, len)
+                            cpu.regs[10] = file_table_read(files, mem, cpu.regs[10], cpu.regs[11], cpu.regs[12]);
+                            break;
+                        case 64: // write(fd, buf, len)
+                            cpu.regs[10] = file_table_write(files, mem, cpu.regs[10], cpu.regs[11], cpu.regs[12]);
+                            break;
+                        case 222: // mmap
+                            cpu.regs[10] = sys_mmap(mem, files, cpu.regs[10], cpu.regs[11],
+                                                    cpu.regs[14], cpu.regs[15]);
                             break;
                         case 3:  // exit
                         case 93: // exit_group
-                            if (log_file) {
+                            console_flush();
+                            file_table_delete(files);
+                            if (log) insn_log_after(log, stats.insns, cpu.regs);
+                            if (log_owner) {
                                 fprintf(log_file, "Program terminated at %08x\n", cpu.pc);
+                                insn_log_delete(log_owner);
                             }
+                            if (trace) {
+                                trace_insn(trace, pc, insn, cpu.regs);
+                                trace_end(trace, TRACE_EXIT, pc, insn);
+                            }
+                            if (btrace) btrace_end(btrace, stats.insns, TRACE_EXIT);
+                            if (timing) timing_thread_insn(timing, pc, insn, pc + 4, 0);
+                            else if (timing_on) timing_insn(&models, pc, insn, pc + 4, 0);
+                            finish_timing(&stats, opts, timing);
+                            finish_blocks(opts, 1);
                             return stats;
                     }
                 }
@@ -208,21 +571,50 @@ struct Stat simulate(struct memory *mem, int start_addr, FILE *log_file, struct
             }
 
             default:
+                drain_console_ring();
+                console_flush();
+                file_table_delete(files);
                 printf("Unhandled instruction at PC = %08x: %08x\n", cpu.pc, insn);
-                if (log_file) {
+                fflush(stdout);
+                flight_recorder_dump(stderr, stats.insns - 1);
+                if (log) insn_log_plain(log, stats.insns, pc, insn);
+                if (log_owner) {
                     fprintf(log_file, "Unhandled instruction\n");
+                    insn_log_delete(log_owner);
                 }
+                if (trace) trace_end(trace, TRACE_UNHANDLED, pc, insn);
+                if (btrace) btrace_end(btrace, stats.insns, TRACE_UNHANDLED);
+                finish_timing(&stats, opts, timing);
+                finish_blocks(opts, 1);
                 return stats;
         }
 
-        // Log register updates if relevant
-        if (log_file) {
-            // Add logging code here based on instruction type
-            fprintf(log_file, "\n");
+        cpu.regs[0] = 0;  // Ensure x0 stays 0
+        if (log) {
+            insn_log_after(log, stats.insns, cpu.regs);
+            if (log_left && --log_left == 0) logging = NULL;
         }
-
+        if (trace) trace_insn(trace, pc, insn, cpu.regs);
+        struct flight_record *rec = &flight_recorder[stats.insns & (FLIGHT_RECORDER_SIZE - 1)];
+        rec->pc = pc;
+        rec->insn = insn;
+        rec->rd_value = cpu.regs[get_field(insn, 7, 5)];
+        if (timing) timing_thread_insn(timing, pc, insn, cpu.pc + 4, mem_addr);
+        else if (timing_on) timing_insn(&models, pc, insn, cpu.pc + 4, mem_addr);
         cpu.pc += 4;  // Move to next instruction
-        cpu.regs[0] = 0;  // Ensure x0 stays 0
+        if (checkpoint_due) {
+            write_checkpoint(&stats, opts->checkpoint, mem, files);
+            file_table_delete(files);
+            if (log_owner) {
+                fprintf(log_file, "Checkpoint written at %08x\n", cpu.pc);
+                insn_log_delete(log_owner);
+            }
+            if (trace) trace_end(trace, TRACE_EXIT, cpu.pc, 0);
+            if (btrace) btrace_end(btrace, stats.insns, TRACE_EXIT);
+            finish_timing(&stats, opts, timing);
+            finish_blocks(opts, 0);
+            return stats;
+        }
     }
 
     return stats;
@@ -3,6 +3,21 @@
 
 #include "memory.h"
 #include "read_elf.h"
+#include "callstack.h"
+#include "profile.h"
+#include "branchstat.h"
+#include "blocks.h"
+#include "trace.h"
+#include "btrace.h"
+#include "timeline.h"
+#include "cache.h"
+#include "stackdist.h"
+#include "bpred.h"
+#include "pipeline.h"
+#include "timing.h"
+#include "bbv.h"
+#include "sampling.h"
+#include "checkpoint.h"
 #include <stdio.h>
 
 // Simuler RISC-V program i givet lager og fra given start adresse
@@ -10,8 +25,62 @@ struct Stat {
     long int insns;         // Number of instructions executed
     long int branches;      // Number of branch instructions encountered
     long int taken_branches; // Number of branches that were taken
+    long int cycles;        // Cycles in the pipeline timing model, 0 without it
 };
 
-struct Stat simulate(struct memory *mem, int start_addr, FILE *log_file, struct symbols* symbols);
+// What the -l log covers. Logging opens at the first block boundary after
+// start_insn instructions where the next block starts at start_pc (any block
+// unless has_start_pc), and closes after max_insns logged instructions
+// (0: no limit). Only instructions in [func_start, func_end) are logged.
+struct log_window {
+    long start_insn;
+    int has_start_pc;
+    uint32_t start_pc;
+    long max_insns;
+    uint32_t func_start;
+    uint32_t func_end;
+};
+
+// Where -W writes a checkpoint and stops: at the first block boundary after
+// at_insn instructions where the next block starts at at_pc (any block
+// unless has_pc). written is 1 once it is written, -1 if that failed.
+struct checkpoint_request {
+    long at_insn;
+    int has_pc;
+    uint32_t at_pc;
+    FILE *out;
+    int written;
+};
+
+// Optional instrumentation - everything is off when zeroed (or opts is NULL)
+struct sim_options {
+    struct callstack *callstack;  // shadow call stack, tracked if non-NULL
+    long sample_interval;         // sample the call stack every this many instructions
+    struct profile *profile;      // statistical profile, sampled on SIGPROF if non-NULL
+    struct branch_stats *branch_stats; // per branch site statistics, if non-NULL
+    struct bpred *bpred;          // branch predictor models, if non-NULL
+    struct pipeline *pipeline;    // pipeline timing, fed by the predictor and caches if present, if non-NULL
+    int timing_thread;            // run the caches, predictors and pipeline on a thread of their own
+    int console_ring;             // empty the memory mapped console ring (see console.h) now and then
+    struct block_counts *blocks;  // basic block execution counts, if non-NULL
+    struct trace_writer *trace;   // binary execution trace, if non-NULL
+    struct btrace_writer *btrace; // branch-only trace, if non-NULL
+    struct log_window *log_window; // limits the -l log, whole run if NULL
+    struct timeline *timeline;    // function spans for a timeline viewer, if non-NULL
+    struct cache *icache;         // instruction cache model, fed by every fetch, if non-NULL
+    struct cache *dcache;         // data cache model, fed by loads and stores, if non-NULL
+    struct stack_dist *stack_dist; // LRU miss ratios of many data caches at once, if non-NULL
+    struct bbv_writer *bbv;       // basic block vectors for SimPoint, if non-NULL
+    struct sample_plan *sample_plan; // time only around simulation points (needs pipeline), if non-NULL
+    struct checkpoint_request *checkpoint; // stop and write a checkpoint, if non-NULL
+    struct checkpoint *restore;   // continue from this checkpoint (start_addr is its pc), if non-NULL
+};
+
+struct Stat simulate(struct memory *mem, int start_addr, FILE *log_file, struct symbols* symbols,
+                     struct sim_options *opts);
+
+// Make the simulator look at pending events at the next basic block boundary.
+// Safe to call from a signal handler.
+void simulate_interrupt(void);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,297 @@
+#include "stackdist.h"
+#include "cache.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_LINE_SIZES 8
+#define MAX_WAYS 16         // largest set associative column in the report
+
+// The accesses to one set. Every line in the set is marked in a Fenwick
+// tree at the time it was last used, so the lines used since time t are
+// the marks after t. Times only grow; when they reach the end of the tree
+// the marked lines are renumbered 1..live.
+struct set_tree {
+    int* tree;          // Fenwick tree over times 1..cap
+    int* owner;         // line index marked at each time, -1 if none
+    int cap;
+    int now;            // last time used
+    int live;           // lines marked
+};
+
+// All caches with 1 << level sets
+struct level {
+    struct set_tree* sets;
+    int hist_len;
+    long* hist;         // accesses per stack distance, hist[hist_len] for larger or first use
+};
+
+struct sweep {
+    int line_size;
+    int line_bits;
+    int num_levels;
+    struct level* levels;
+    // the distinct lines seen, and for each the time of its last use at each level
+    uint32_t* lines;
+    int* times;         // num_lines * num_levels, 0 if not used yet
+    int num_lines;
+    int lines_cap;
+    int* hash;          // line -> index in lines, -1 if empty
+    int hash_mask;
+};
+
+struct stack_dist {
+    long max_size;
+    long accesses;
+    int num_sweeps;
+    struct sweep sweeps[MAX_LINE_SIZES];
+};
+
+static int log2_exact(long v)
+{
+    int bits = 0;
+    while ((1L << bits) < v)
+        bits++;
+    return (1L << bits) == v ? bits : -1;
+}
+
+static void sweep_init(struct sweep* s, int line_size, long max_size)
+{
+    s->line_size = line_size;
+    s->line_bits = log2_exact(line_size);
+    long max_lines = max_size / line_size;
+    s->num_levels = log2_exact(max_lines) + 1;
+    s->levels = calloc(s->num_levels, sizeof(struct level));
+    for (int l = 0; l < s->num_levels; l++) {
+        struct level* lev = &s->levels[l];
+        lev->sets = calloc(1L << l, sizeof(struct set_tree));
+        // only the single set level needs distances beyond MAX_WAYS, for fully associative caches
+        lev->hist_len = l == 0 ? max_lines : (max_lines >> l < MAX_WAYS ? max_lines >> l : MAX_WAYS);
+        lev->hist = calloc(lev->hist_len + 1, sizeof(long));
+    }
+    s->hash_mask = 1023;
+    s->hash = malloc((s->hash_mask + 1) * sizeof(int));
+    memset(s->hash, 0xff, (s->hash_mask + 1) * sizeof(int));
+}
+
+static void sweep_free(struct sweep* s)
+{
+    for (int l = 0; l < s->num_levels; l++) {
+        struct level* lev = &s->levels[l];
+        for (long i = 0; i < 1L << l; i++) {
+            free(lev->sets[i].tree);
+            free(lev->sets[i].owner);
+        }
+        free(lev->sets);
+        free(lev->hist);
+    }
+    free(s->levels);
+    free(s->lines);
+    free(s->times);
+    free(s->hash);
+}
+
+struct stack_dist* stack_dist_create(const char* spec)
+{
+    int line_sizes[MAX_LINE_SIZES];
+    int n = 0;
+    long max_size = 1024 * 1024;
+    char* end = (char*)spec;
+    do {
+        if (n == MAX_LINE_SIZES)
+            return NULL;
+        line_sizes[n] = cache_parse_size(end, &end);
+        if (line_sizes[n] < 4 || log2_exact(line_sizes[n]) < 0)
+            return NULL;
+        n++;
+    } while (*end++ == ',');
+    if (end[-1] == ':') {
+        max_size = cache_parse_size(end, &end);
+        end++;
+    }
+    if (end[-1] != '\0' || log2_exact(max_size) < 0)
+        return NULL;
+    for (int i = 0; i < n; i++)
+        if (line_sizes[i] > max_size)
+            return NULL;
+
+    struct stack_dist* sd = calloc(1, sizeof(struct stack_dist));
+    sd->max_size = max_size;
+    sd->num_sweeps = n;
+    for (int i = 0; i < n; i++)
+        sweep_init(&sd->sweeps[i], line_sizes[i], max_size);
+    return sd;
+}
+
+void stack_dist_delete(struct stack_dist* sd)
+{
+    for (int i = 0; i < sd->num_sweeps; i++)
+        sweep_free(&sd->sweeps[i]);
+    free(sd);
+}
+
+static inline uint32_t hash_line(uint32_t line)
+{
+    return line * 0x9e3779b1u;
+}
+
+static void grow_hash(struct sweep* s)
+{
+    free(s->hash);
+    s->hash_mask = s->hash_mask * 2 + 1;
+    s->hash = malloc((s->hash_mask + 1) * sizeof(int));
+    memset(s->hash, 0xff, (s->hash_mask + 1) * sizeof(int));
+    for (int i = 0; i < s->num_lines; i++) {
+        uint32_t h = hash_line(s->lines[i]) & s->hash_mask;
+        while (s->hash[h] >= 0)
+            h = (h + 1) & s->hash_mask;
+        s->hash[h] = i;
+    }
+}
+
+// index of line, added with no uses if it is new
+static int line_index(struct sweep* s, uint32_t line)
+{
+    uint32_t h = hash_line(line) & s->hash_mask;
+    while (s->hash[h] >= 0) {
+        if (s->lines[s->hash[h]] == line)
+            return s->hash[h];
+        h = (h + 1) & s->hash_mask;
+    }
+    if (s->num_lines == s->lines_cap) {
+        s->lines_cap = s->lines_cap ? s->lines_cap * 2 : 1024;
+        s->lines = realloc(s->lines, s->lines_cap * sizeof(uint32_t));
+        s->times = realloc(s->times, (size_t)s->lines_cap * s->num_levels * sizeof(int));
+    }
+    int index = s->num_lines++;
+    s->lines[index] = line;
+    memset(&s->times[(size_t)index * s->num_levels], 0, s->num_levels * sizeof(int));
+    s->hash[h] = index;
+    if (s->num_lines * 2 > s->hash_mask)
+        grow_hash(s);
+    return index;
+}
+
+// marks at times 1..t
+static inline int prefix(const struct set_tree* st, int t)
+{
+    int sum = 0;
+    for (; t > 0; t -= t & -t)
+        sum += st->tree[t];
+    return sum;
+}
+
+static inline void add(struct set_tree* st, int t, int delta)
+{
+    for (; t <= st->cap; t += t & -t)
+        st->tree[t] += delta;
+}
+
+// renumber the marked lines 1..live, making room for at least as many new times
+static void compact(struct sweep* s, int level, struct set_tree* st)
+{
+    int cap = st->live * 2 > 16 ? st->live * 2 : 16;
+    int* owner = malloc((cap + 1) * sizeof(int));
+    int k = 0;
+    for (int t = 1; t <= st->now; t++) {
+        if (st->owner[t] >= 0) {
+            owner[++k] = st->owner[t];
+            s->times[(size_t)owner[k] * s->num_levels + level] = k;
+        }
+    }
+    for (int t = k + 1; t <= cap; t++)
+        owner[t] = -1;
+    free(st->owner);
+    free(st->tree);
+    st->owner = owner;
+    st->tree = calloc(cap + 1, sizeof(int));
+    st->cap = cap;
+    st->now = k;
+    // build the tree for marks at 1..k in linear time
+    for (int t = 1; t <= k; t++)
+        st->tree[t] = 1;
+    for (int t = 1; t <= cap; t++) {
+        int parent = t + (t & -t);
+        if (parent <= cap)
+            st->tree[parent] += st->tree[t];
+    }
+}
+
+void stack_dist_access(struct stack_dist* sd, uint32_t addr)
+{
+    sd->accesses++;
+    for (int i = 0; i < sd->num_sweeps; i++) {
+        struct sweep* s = &sd->sweeps[i];
+        uint32_t line = addr >> s->line_bits;
+        int index = line_index(s, line);
+        int* times = &s->times[(size_t)index * s->num_levels];
+        for (int l = 0; l < s->num_levels; l++) {
+            struct level* lev = &s->levels[l];
+            struct set_tree* st = &lev->sets[line & ((1u << l) - 1)];
+            int t = times[l];
+            if (t && t == st->now) {
+                // the most recent line in its set, and so in every smaller set
+                for (; l < s->num_levels; l++)
+                    s->levels[l].hist[0]++;
+                break;
+            }
+            int dist = lev->hist_len;
+            if (t) {
+                dist = st->live - prefix(st, t);
+                if (dist > lev->hist_len)
+                    dist = lev->hist_len;
+                add(st, t, -1);
+                st->owner[t] = -1;
+                st->live--;
+            }
+            lev->hist[dist]++;
+            if (st->now == st->cap)
+                compact(s, l, st);
+            t = ++st->now;
+            add(st, t, 1);
+            st->owner[t] = index;
+            st->live++;
+            times[l] = t;
+        }
+    }
+}
+
+static double miss_ratio(const struct level* lev, long accesses, long ways)
+{
+    long hits = 0;
+    for (long d = 0; d < ways; d++)
+        hits += lev->hist[d];
+    return accesses ? 100.0 * (accesses - hits) / accesses : 0.0;
+}
+
+void stack_dist_write_report(struct stack_dist* sd, FILE* out)
+{
+    static const int ways[] = { 1, 2, 4, 8, 16 };
+    const int num_ways = sizeof(ways) / sizeof(ways[0]);
+    for (int i = 0; i < sd->num_sweeps; i++) {
+        struct sweep* s = &sd->sweeps[i];
+        fprintf(out, "LRU miss ratios, %d byte lines: %ld accesses, %d distinct lines\n",
+                s->line_size, sd->accesses, s->num_lines);
+        fprintf(out, "  %8s %8s", "size", "direct");
+        for (int w = 1; w < num_ways; w++)
+            fprintf(out, " %5d-way", ways[w]);
+        fprintf(out, " %8s\n", "full");
+        long first = s->line_size > 1024 ? s->line_size : 1024;
+        for (long size = first; size <= sd->max_size; size *= 2) {
+            if (size >= 1024 * 1024)
+                fprintf(out, "  %7ldm", size / (1024 * 1024));
+            else
+                fprintf(out, "  %7ldk", size / 1024);
+            for (int w = 0; w < num_ways; w++) {
+                long sets = size / s->line_size / ways[w];
+                if (sets < 1) {
+                    fprintf(out, " %*s", w ? 9 : 8, "-");
+                    continue;
+                }
+                double r = miss_ratio(&s->levels[log2_exact(sets)], sd->accesses, ways[w]);
+                fprintf(out, " %*.2f%%", w ? 8 : 7, r);
+            }
+            fprintf(out, " %7.2f%%\n", miss_ratio(&s->levels[0], sd->accesses, size / s->line_size));
+        }
+        fprintf(out, "\n");
+    }
+}
@@ -0,0 +1,29 @@
+#ifndef __STACKDIST_H__
+#define __STACKDIST_H__
+
+#include <stdint.h>
+#include <stdio.h>
+
+// Miss ratios of many LRU caches from a single run (Mattson's stack
+// algorithm). For every line size and every power of two number of sets,
+// each access records its LRU stack distance within its set: the number of
+// distinct lines in that set used since the last access to the same line.
+// A cache with that many sets and A ways hits exactly when the distance is
+// below A, so one histogram per set count gives every associativity, and
+// the single set histogram gives fully associative caches of every size.
+// Distances are counted with a Fenwick tree over access times in each set.
+struct stack_dist;
+
+// parse "line[,line...][:max]", e.g. "32,64:1m": line sizes in bytes, and
+// the largest cache size in the curve (default 1m). NULL if not valid.
+struct stack_dist* stack_dist_create(const char* spec);
+void stack_dist_delete(struct stack_dist* sd);
+
+// a load or store of addr
+void stack_dist_access(struct stack_dist* sd, uint32_t addr);
+
+// write a miss ratio table per line size: cache sizes from 1k up to the
+// largest, for direct mapped, 2, 4, 8 and 16 ways and fully associative
+void stack_dist_write_report(struct stack_dist* sd, FILE* out);
+
+#endif
@@ -16,7 +16,8 @@ flags = {"march": "-march=rv32im",
          "opt0": "-O0",
          "opt1": "-O1",
          "opt2": "-O2",
-         "opt3": "-O3"
+         "opt3": "-O3",
+         "debug": "-g"
         }
 
 for key, value in flags.items():
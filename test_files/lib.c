@@ -35,6 +35,23 @@ void outp(char c) {
   asm volatile("  ecall");
 }
 
+// Output through the simulator's memory mapped console ring - no ecall.
+// The simulator empties the ring every few thousand instructions when it
+// runs with -O. Without it, this waits for ever once the ring is full.
+#define CONSOLE_RING_HEAD ((volatile unsigned*)0x1ff0000)
+#define CONSOLE_RING_TAIL ((volatile unsigned*)0x1ff0004)
+#define CONSOLE_RING_DATA ((volatile char*)0x1ff1000)
+#define CONSOLE_RING_SIZE 0x8000
+
+void outp_mmio(char c) {
+  unsigned head = *CONSOLE_RING_HEAD;
+  while (head - *CONSOLE_RING_TAIL == CONSOLE_RING_SIZE) {
+    // full - wait for the simulator to catch up
+  }
+  CONSOLE_RING_DATA[head & (CONSOLE_RING_SIZE - 1)] = c;
+  *CONSOLE_RING_HEAD = head + 1;
+}
+
 void terminate(int status) {
   asm volatile("  mv a0,%0" : : "r" (status));
   asm volatile("  li a7,3");
@@ -48,8 +65,9 @@ int read_int_buffer(int file, int* buffer, int max_size) {
   asm volatile("  mv a1,%0" : : "r" (buffer) : "a1");
   asm volatile("  mv a2,%0" : : "r" (max_size) : "a2");
   asm volatile("  li a7,4" : : : "a7");
-  asm volatile("  ecall" : : : "a0");
+  asm volatile("  ecall" : : : "a0", "memory");
   asm volatile("  mv %0,a0" : "=r" (retval));
+  return retval;
 }
 
 int write_int_buffer(int file, int* buffer, int size) {
@@ -58,8 +76,9 @@ int write_int_buffer(int file, int* buffer, int size) {
   asm volatile("  mv a1,%0" : : "r" (buffer) : "a1");
   asm volatile("  mv a2,%0" : : "r" (size) : "a2");
   asm volatile("  li a7,5" : : : "a7");
-  asm volatile("  ecall" : : : "a0");
+  asm volatile("  ecall" : : : "a0", "memory");
   asm volatile("  mv %0,a0" : "=r" (retval));
+  return retval;
 }
 
 int open_file(char* path, char* flags) {
@@ -69,30 +88,69 @@ int open_file(char* path, char* flags) {
   asm volatile("  li a7,6" : : : "a7");
   asm volatile("  ecall" : : : "a0");
   asm volatile("  mv %0,a0" : "=r" (retval));
+  return retval;
 }
 
 int close_file(int file) {
   int retval;
   asm volatile("  mv a0,%0" : : "r" (file) : "a0");
-  asm volatile("  li a7,6" : : : "a7");
+  asm volatile("  li a7,7" : : : "a7");
   asm volatile("  ecall" : : : "a0");
   asm volatile("  mv %0,a0" : "=r" (retval));
+  return retval;
+}
+
+// the arguments are bound to their registers in one asm statement, so the
+// compiler can't use a0-a2 for anything else between loading them and the ecall
+int write(int file, const char* buffer, int size) {
+  register int a0 asm("a0") = file;
+  register const char* a1 asm("a1") = buffer;
+  register int a2 asm("a2") = size;
+  register int a7 asm("a7") = 64;
+  asm volatile("  ecall" : "+r" (a0) : "r" (a1), "r" (a2), "r" (a7) : "memory");
+  return a0;
+}
+
+// reads at most one line from the console
+int read(int file, char* buffer, int max_size) {
+  register int a0 asm("a0") = file;
+  register char* a1 asm("a1") = buffer;
+  register int a2 asm("a2") = max_size;
+  register int a7 asm("a7") = 63;
+  asm volatile("  ecall" : "+r" (a0) : "r" (a1), "r" (a2), "r" (a7) : "memory");
+  return a0;
 }
 
+// map a file opened with open_file into memory, copy-on-write.
+// offset must be a multiple of 64K. Returns NULL on failure.
+void* map_file(int file, int offset, int length) {
+  register int a0 asm("a0") = 0;    // no address, the simulator picks one
+  register int a1 asm("a1") = length;
+  register int a2 asm("a2") = 3;    // PROT_READ | PROT_WRITE
+  register int a3 asm("a3") = 2;    // MAP_PRIVATE
+  register int a4 asm("a4") = file;
+  register int a5 asm("a5") = offset;
+  register int a7 asm("a7") = 222;
+  asm volatile("  ecall" : "+r" (a0) : "r" (a1), "r" (a2), "r" (a3), "r" (a4), "r" (a5), "r" (a7) : "memory");
+  return a0 == -1 ? NULL : (void*)a0;
+}
 
 void print_string(const char* p) {
-  while (*p) { outp(*p++); };
+  // one ecall for the whole string
+  const char* end = p;
+  while (*end) end++;
+  write(1, p, end - p);
 }
 
 void read_string(char* buffer, int max_chars) {
-  int c = inp();
-  while (c != '\n' && c != '\r' && max_chars > 1) {
-    *buffer++ = c;
-    --max_chars;
-    c = inp();
+  int len = 0;
+  if (max_chars > 1) {
+    len = read(0, buffer, max_chars - 1);
+    if (len < 0) len = 0;
   }
-  // zero terminate:
-  *buffer = 0;
+  // drop the line end and zero terminate:
+  while (len > 0 && (buffer[len - 1] == '\n' || buffer[len - 1] == '\r')) --len;
+  buffer[len] = 0;
 }
 
 
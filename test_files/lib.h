@@ -5,11 +5,15 @@
 
 char inp();
 void outp(char);
+void outp_mmio(char);
 void terminate(int status);
 int read_int_buffer(int file, int* buffer, int max_size);
 int write_int_buffer(int file, int* buffer, int size);
 int open_file(char* path, char* flags);
 int close_file(int file);
+int write(int file, const char* buffer, int size);
+int read(int file, char* buffer, int max_size);
+void* map_file(int file, int offset, int length);
 void print_string(const char* p);
 void read_string(char* buffer, int max_chars);
 unsigned int str_to_uns(const char* str);
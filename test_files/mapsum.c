@@ -0,0 +1,51 @@
+#include "lib.h"
+
+// Sum the bytes of a file twice, once read with read and once from a
+// mapping of the file, and check that they agree:
+//   sim mapsum.riscv -- file
+
+char buffer[4096];
+
+void print_uns(const char* label, unsigned int val) {
+  char digits[12];
+  print_string(label);
+  uns_to_str(digits, val);
+  print_string(digits);
+  print_string("\n");
+}
+
+int main(int argc, const char* argv[]) {
+  if (argc < 2) {
+    print_string("Usage: mapsum.riscv -- file\n");
+    return 1;
+  }
+  int file = open_file((char*)argv[1], "r");
+  if (file < 0) {
+    print_string("Could not open the file\n");
+    return 1;
+  }
+  unsigned int length = 0, read_sum = 0;
+  int got;
+  while ((got = read(file, buffer, sizeof(buffer))) > 0) {
+    for (int i = 0; i < got; i++) read_sum += (unsigned char)buffer[i];
+    length += got;
+  }
+  if (length == 0) {
+    print_string("The file is empty\n");
+    return 1;
+  }
+  const unsigned char* mapped = map_file(file, 0, length);
+  // the mapping stays when the file is closed
+  close_file(file);
+  if (mapped == NULL) {
+    print_string("Could not map the file\n");
+    return 1;
+  }
+  unsigned int mapped_sum = 0;
+  for (unsigned int i = 0; i < length; i++) mapped_sum += mapped[i];
+  print_uns("bytes: ", length);
+  print_uns("sum read: ", read_sum);
+  print_uns("sum mapped: ", mapped_sum);
+  print_string(read_sum == mapped_sum ? "ok\n" : "MISMATCH\n");
+  return read_sum != mapped_sum;
+}
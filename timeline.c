@@ -0,0 +1,110 @@
+#include "timeline.h"
+#include "callstack.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define BUFFER_SIZE (1 << 20)
+#define MAX_EVENT_SIZE 256
+
+struct timeline {
+    FILE* out;
+    struct symbols* symbols;
+    uint32_t* return_addrs;     // one per open span, except the outermost
+    int depth;
+    int max_depth;
+    char* buffer;
+    size_t used;
+    int num_events;
+};
+
+static void flush(struct timeline* tl)
+{
+    fwrite(tl->buffer, 1, tl->used, tl->out);
+    tl->used = 0;
+}
+
+static void append(struct timeline* tl, const char* text, size_t len)
+{
+    if (tl->used + len > BUFFER_SIZE)
+        flush(tl);
+    memcpy(tl->buffer + tl->used, text, len);
+    tl->used += len;
+}
+
+static void begin_span(struct timeline* tl, long insns, uint32_t func)
+{
+    const char* name = NULL;
+    if (tl->symbols) {
+        name = symbols_addr_to_func(tl->symbols, func, NULL);
+        if (name == NULL)
+            name = symbols_value_to_sym(tl->symbols, func);
+    }
+    if (tl->used + MAX_EVENT_SIZE > BUFFER_SIZE)
+        flush(tl);
+    char* p = tl->buffer + tl->used;
+    int len;
+    // symbol names are C identifiers and need no escaping
+    if (name)
+        len = snprintf(p, MAX_EVENT_SIZE, "%s\n{\"name\":\"%.160s\",\"ph\":\"B\",\"ts\":%ld,\"pid\":1,\"tid\":1}",
+                       tl->num_events ? "," : "", name, insns);
+    else
+        len = snprintf(p, MAX_EVENT_SIZE, "%s\n{\"name\":\"0x%x\",\"ph\":\"B\",\"ts\":%ld,\"pid\":1,\"tid\":1}",
+                       tl->num_events ? "," : "", func, insns);
+    tl->used += len;
+    tl->num_events++;
+}
+
+static void end_span(struct timeline* tl, long insns)
+{
+    if (tl->used + MAX_EVENT_SIZE > BUFFER_SIZE)
+        flush(tl);
+    tl->used += snprintf(tl->buffer + tl->used, MAX_EVENT_SIZE,
+                         ",\n{\"ph\":\"E\",\"ts\":%ld,\"pid\":1,\"tid\":1}", insns);
+    tl->num_events++;
+}
+
+struct timeline* timeline_create(FILE* out, struct symbols* symbols, uint32_t start_addr)
+{
+    struct timeline* tl = calloc(1, sizeof(struct timeline));
+    tl->out = out;
+    tl->symbols = symbols;
+    tl->max_depth = 256;
+    tl->return_addrs = malloc(tl->max_depth * sizeof(uint32_t));
+    tl->buffer = malloc(BUFFER_SIZE);
+    const char* header = "{\"traceEvents\":[";
+    append(tl, header, strlen(header));
+    begin_span(tl, 0, start_addr);
+    return tl;
+}
+
+void timeline_call(struct timeline* tl, long insns, uint32_t target, uint32_t return_addr)
+{
+    if (tl->depth == tl->max_depth) {
+        tl->max_depth *= 2;
+        tl->return_addrs = realloc(tl->return_addrs, tl->max_depth * sizeof(uint32_t));
+    }
+    tl->return_addrs[tl->depth++] = return_addr;
+    begin_span(tl, insns, target);
+}
+
+void timeline_return(struct timeline* tl, long insns, uint32_t target)
+{
+    int i = callstack_match_return(tl->return_addrs, tl->depth, target);
+    while (i >= 0 && tl->depth > i) {
+        end_span(tl, insns);
+        tl->depth--;
+    }
+}
+
+void timeline_close(struct timeline* tl, long insns)
+{
+    // the outermost span has no return address
+    for (int i = tl->depth; i >= 0; i--)
+        end_span(tl, insns);
+    const char* footer = "\n],\"otherData\":{\"ts\":\"instructions executed\"}}\n";
+    append(tl, footer, strlen(footer));
+    flush(tl);
+    free(tl->buffer);
+    free(tl->return_addrs);
+    free(tl);
+}
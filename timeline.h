@@ -0,0 +1,26 @@
+#ifndef __TIMELINE_H__
+#define __TIMELINE_H__
+
+#include "read_elf.h"
+#include <stdint.h>
+#include <stdio.h>
+
+// Function spans of the simulated program in the Chrome trace event JSON
+// format, for timeline viewers like Perfetto or chrome://tracing. Calls
+// and returns are found the same way as for the shadow call stack. The
+// timestamp is the number of instructions executed, shown as microseconds.
+// Events are collected in a large buffer and written in batches.
+struct timeline;
+
+struct timeline* timeline_create(FILE* out, struct symbols* symbols, uint32_t start_addr);
+
+// a call to 'target' which will return to 'return_addr', at time 'insns'
+void timeline_call(struct timeline* tl, long insns, uint32_t target, uint32_t return_addr);
+// a return to 'target' - spans are closed until one expecting 'target' is found
+void timeline_return(struct timeline* tl, long insns, uint32_t target);
+
+// close all open spans at time 'insns', finish the JSON and delete the
+// timeline (the file is not closed)
+void timeline_close(struct timeline* tl, long insns);
+
+#endif
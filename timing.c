@@ -0,0 +1,150 @@
+#include "timing.h"
+#include "ringbuf.h"
+#include "helper.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+
+#define BATCH_RECORDS 1024      // records collected before they go into the ring
+
+struct timing_record {
+    uint32_t pc;
+    uint32_t insn;
+    uint32_t next_pc;
+    uint32_t addr;
+};
+
+struct timing_thread {
+    struct timing_models models;
+    struct ringbuf ring;
+    pthread_t thread;
+    atomic_int stopping;
+    int batched;
+    struct timing_record batch[BATCH_RECORDS];
+};
+
+void timing_insn(const struct timing_models* m, uint32_t pc, uint32_t insn, uint32_t next_pc, uint32_t addr)
+{
+    struct pipeline* pipeline = m->pipeline;
+    if (m->icache && !cache_fetch(m->icache, pc) && pipeline)
+        pipeline_cache_miss(pipeline, 0);
+    if (pipeline)
+        pipeline_insn(pipeline, pc, insn);
+
+    switch (insn & 0x7f) {
+        case 0x03:  // load
+        case 0x23:  // store
+            if (m->dcache && !cache_access(m->dcache, pc, addr, (insn & 0x7f) == 0x23) && pipeline)
+                pipeline_cache_miss(pipeline, 1);
+            if (m->stack_dist)
+                stack_dist_access(m->stack_dist, addr);
+            break;
+        case 0x63: { // branch
+            int taken = next_pc != pc + 4;
+            if (m->bpred) {
+                int imm = sign_extend((get_bits(insn, 31, 1) << 12) | (get_bits(insn, 7, 1) << 11) |
+                                      (get_bits(insn, 25, 6) << 5) | (get_bits(insn, 8, 4) << 1), 13);
+                if (bpred_branch(m->bpred, pc, pc + imm, taken) && pipeline)
+                    pipeline_mispredict(pipeline);
+            } else if (pipeline && taken) {
+                pipeline_mispredict(pipeline);  // without a model, predict not taken
+            }
+            break;
+        }
+        case 0x6f: { // jal
+            int rd = get_bits(insn, 7, 5);
+            if (m->bpred && rd == 1)
+                bpred_call(m->bpred, pc + 4);
+            if (pipeline)
+                pipeline_jump(pipeline);
+            break;
+        }
+        case 0x67: { // jalr
+            int rd = get_bits(insn, 7, 5);
+            int rs1 = get_bits(insn, 15, 5);
+            int miss = 1;   // the target is known in EX, unless the return address stack has it
+            if (m->bpred) {
+                if (rd == 1)
+                    bpred_call(m->bpred, pc + 4);
+                else if (rd == 0 && rs1 == 1)
+                    miss = bpred_return(m->bpred, pc, next_pc);
+            }
+            if (pipeline && miss)
+                pipeline_mispredict(pipeline);
+            break;
+        }
+    }
+}
+
+static void* consumer_thread(void* arg)
+{
+    struct timing_thread* tt = arg;
+    for (;;) {
+        const void* data;
+        size_t len = ringbuf_peek(&tt->ring, &data);
+        if (len) {
+            // producers write whole batches and the ring size is a multiple of a record
+            const struct timing_record* r = data;
+            size_t n = len / sizeof(struct timing_record);
+            for (size_t i = 0; i < n; i++)
+                timing_insn(&tt->models, r[i].pc, r[i].insn, r[i].next_pc, r[i].addr);
+            ringbuf_consume(&tt->ring, n * sizeof(struct timing_record));
+        } else if (atomic_load(&tt->stopping)) {
+            // the last batch was written before stopping was set
+            if (ringbuf_used(&tt->ring) == 0)
+                break;
+        } else {
+            sched_yield();
+        }
+    }
+    return NULL;
+}
+
+struct timing_thread* timing_thread_start(const struct timing_models* m, size_t ring_size)
+{
+    struct timing_thread* tt = calloc(1, sizeof(struct timing_thread));
+    tt->models = *m;
+    ringbuf_init(&tt->ring, ring_size);
+    atomic_init(&tt->stopping, 0);
+    if (pthread_create(&tt->thread, NULL, consumer_thread, tt)) {
+        ringbuf_free(&tt->ring);
+        free(tt);
+        return NULL;
+    }
+    return tt;
+}
+
+static void flush_batch(struct timing_thread* tt)
+{
+    const unsigned char* data = (const unsigned char*)tt->batch;
+    size_t size = tt->batched * sizeof(struct timing_record);
+    size_t done = 0;
+    while (done < size) {
+        size_t n = ringbuf_write(&tt->ring, data + done, size - done);
+        done += n;
+        if (n == 0)
+            sched_yield();      // ring is full, let the models catch up
+    }
+    tt->batched = 0;
+}
+
+void timing_thread_insn(struct timing_thread* tt, uint32_t pc, uint32_t insn, uint32_t next_pc, uint32_t addr)
+{
+    struct timing_record* r = &tt->batch[tt->batched];
+    r->pc = pc;
+    r->insn = insn;
+    r->next_pc = next_pc;
+    r->addr = addr;
+    if (++tt->batched == BATCH_RECORDS)
+        flush_batch(tt);
+}
+
+void timing_thread_stop(struct timing_thread* tt)
+{
+    flush_batch(tt);
+    atomic_store(&tt->stopping, 1);
+    pthread_join(tt->thread, NULL);
+    ringbuf_free(&tt->ring);
+    free(tt);
+}
@@ -0,0 +1,40 @@
+#ifndef __TIMING_H__
+#define __TIMING_H__
+
+#include "cache.h"
+#include "stackdist.h"
+#include "bpred.h"
+#include "pipeline.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// The timing models, any of which may be NULL. They only need to know, per
+// executed instruction, its pc and encoding, the pc after it and for loads
+// and stores the address, so the functional simulator can hand them that
+// directly or through a thread.
+struct timing_models {
+    struct cache* icache;
+    struct cache* dcache;
+    struct stack_dist* stack_dist;
+    struct bpred* bpred;
+    struct pipeline* pipeline;
+};
+
+// feed one executed instruction to the models
+void timing_insn(const struct timing_models* m, uint32_t pc, uint32_t insn, uint32_t next_pc, uint32_t addr);
+
+// Run the models on their own thread. The simulator's records go through a
+// lock-free ring (see ringbuf.h) in batches, so the functional loop and the
+// models run in parallel on two cores. Returns NULL if no thread could be
+// started.
+struct timing_thread;
+
+struct timing_thread* timing_thread_start(const struct timing_models* m, size_t ring_size);
+
+// like timing_insn, but queued for the thread
+void timing_thread_insn(struct timing_thread* tt, uint32_t pc, uint32_t insn, uint32_t next_pc, uint32_t addr);
+
+// wait until the thread has fed every queued instruction to the models, and stop it
+void timing_thread_stop(struct timing_thread* tt);
+
+#endif
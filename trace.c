@@ -0,0 +1,295 @@
+#include "trace.h"
+#include "helper.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define INSN_CACHE_SIZE 16384
+#define WRITE_BUFFER_SIZE (1 << 20)
+
+struct insn_cache_entry {
+    uint32_t pc;
+    uint32_t insn;
+};
+
+// State mirrored by writer and reader, so both agree on what is left out
+struct trace_state {
+    uint32_t next_pc;
+    uint32_t regs[32];
+    struct insn_cache_entry insns[INSN_CACHE_SIZE];
+};
+
+struct trace_writer {
+    FILE* out;
+    struct trace_state state;
+    size_t used;
+    unsigned char buffer[WRITE_BUFFER_SIZE];
+};
+
+struct trace_reader {
+    FILE* in;
+    struct trace_state state;
+    int done;
+};
+
+static inline struct insn_cache_entry* insn_cache_slot(struct trace_state* s, uint32_t pc)
+{
+    return &s->insns[(pc >> 2) & (INSN_CACHE_SIZE - 1)];
+}
+
+static inline uint32_t zigzag(int32_t v)
+{
+    return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+static inline int32_t unzigzag(uint32_t v)
+{
+    return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+}
+
+// Does the instruction write rd? Stores, branches and ecall do not.
+static inline int writes_rd(uint32_t insn)
+{
+    switch (insn & 0x7f) {
+        case 0x33: case 0x13: case 0x03: case 0x17: case 0x37: case 0x6f: case 0x67:
+            return get_bits(insn, 7, 5) != 0;
+        default:
+            return 0;
+    }
+}
+
+static inline uint32_t mem_address(struct trace_state* s, uint32_t insn)
+{
+    uint32_t rs1 = get_bits(insn, 15, 5);
+    int32_t imm;
+    if ((insn & 0x7f) == 0x23)
+        imm = sign_extend((get_bits(insn, 25, 7) << 5) | get_bits(insn, 7, 5), 12);
+    else
+        imm = sign_extend(get_bits(insn, 20, 12), 12);
+    return s->regs[rs1] + imm;
+}
+
+static inline uint32_t store_data(struct trace_state* s, uint32_t insn)
+{
+    uint32_t data = s->regs[get_bits(insn, 20, 5)];
+    switch (get_bits(insn, 12, 3)) {
+        case 0: return data & 0xff;
+        case 1: return data & 0xffff;
+        default: return data;
+    }
+}
+
+static inline int mem_size(uint32_t insn)
+{
+    return 1 << (get_bits(insn, 12, 3) & 3);
+}
+
+static void flush(struct trace_writer* tw)
+{
+    fwrite(tw->buffer, 1, tw->used, tw->out);
+    tw->used = 0;
+}
+
+static inline void put_byte(struct trace_writer* tw, unsigned char b)
+{
+    tw->buffer[tw->used++] = b;
+}
+
+static inline void put_varint(struct trace_writer* tw, uint32_t v)
+{
+    while (v >= 0x80) {
+        put_byte(tw, (v & 0x7f) | 0x80);
+        v >>= 7;
+    }
+    put_byte(tw, v);
+}
+
+static inline void put_word(struct trace_writer* tw, uint32_t v)
+{
+    for (int i = 0; i < 4; i++)
+        put_byte(tw, v >> (8 * i));
+}
+
+struct trace_writer* trace_writer_create(FILE* out)
+{
+    struct trace_writer* tw = calloc(1, sizeof(struct trace_writer));
+    tw->out = out;
+    return tw;
+}
+
+void trace_begin(struct trace_writer* tw, uint32_t start_pc, const uint32_t regs[32])
+{
+    tw->state.next_pc = start_pc;
+    memcpy(tw->state.regs, regs, sizeof(tw->state.regs));
+    tw->state.regs[0] = 0;
+    uint32_t mask = 0;
+    for (int i = 1; i < 32; i++)
+        if (regs[i])
+            mask |= 1u << i;
+    memcpy(tw->buffer, "RVT1", 4);
+    tw->used = 4;
+    put_word(tw, start_pc);
+    put_word(tw, mask);
+    for (int i = 1; i < 32; i++)
+        if (regs[i])
+            put_word(tw, regs[i]);
+}
+
+void trace_insn(struct trace_writer* tw, uint32_t pc, uint32_t insn, const uint32_t regs[32])
+{
+    struct trace_state* s = &tw->state;
+    // a record is at most 1 + 5 + 4 + 6 bytes
+    if (tw->used > WRITE_BUFFER_SIZE - 32)
+        flush(tw);
+    size_t tag_pos = tw->used++;
+    unsigned char tag = 0;
+    if (pc != s->next_pc) {
+        tag |= TRACE_JUMP;
+        put_varint(tw, zigzag(pc - s->next_pc));
+    }
+    struct insn_cache_entry* slot = insn_cache_slot(s, pc);
+    if (slot->pc != pc || slot->insn != insn) {
+        tag |= TRACE_INSN;
+        put_word(tw, insn);
+        slot->pc = pc;
+        slot->insn = insn;
+    }
+    uint32_t opcode = insn & 0x7f;
+    if (writes_rd(insn) || opcode == 0x73) {
+        // an ecall may return a value in a0
+        uint32_t rd = opcode == 0x73 ? 10 : get_bits(insn, 7, 5);
+        if (opcode != 0x73 || regs[rd] != s->regs[rd]) {
+            tag |= TRACE_REG;
+            put_byte(tw, rd);
+            put_varint(tw, zigzag(regs[rd] - s->regs[rd]));
+        }
+    }
+    tw->buffer[tag_pos] = tag;
+    memcpy(s->regs, regs, sizeof(s->regs));
+    s->regs[0] = 0;
+    s->next_pc = pc + 4;
+    // jumps and taken branches show up as a pc delta on the next record
+}
+
+void trace_end(struct trace_writer* tw, enum trace_end_reason reason, uint32_t pc, uint32_t insn)
+{
+    if (tw->used > WRITE_BUFFER_SIZE - 32)
+        flush(tw);
+    put_byte(tw, TRACE_END | reason);
+    if (reason == TRACE_UNHANDLED) {
+        put_varint(tw, pc);
+        put_word(tw, insn);
+    }
+}
+
+void trace_writer_close(struct trace_writer* tw)
+{
+    flush(tw);
+    fflush(tw->out);
+    free(tw);
+}
+
+static inline int get_byte(struct trace_reader* tr)
+{
+    return getc(tr->in);
+}
+
+static uint32_t get_varint(struct trace_reader* tr)
+{
+    uint32_t v = 0;
+    int shift = 0, b;
+    do {
+        b = get_byte(tr);
+        if (b == EOF)
+            break;
+        if (shift < 32)
+            v |= (uint32_t)(b & 0x7f) << shift;
+        shift += 7;
+    } while (b & 0x80);
+    return v;
+}
+
+static uint32_t get_word(struct trace_reader* tr)
+{
+    uint32_t v = 0;
+    for (int i = 0; i < 4; i++)
+        v |= (uint32_t)(get_byte(tr) & 0xff) << (8 * i);
+    return v;
+}
+
+struct trace_reader* trace_reader_open(FILE* in)
+{
+    char magic[4];
+    if (fread(magic, 1, 4, in) != 4 || memcmp(magic, "RVT1", 4) != 0)
+        return NULL;
+    struct trace_reader* tr = calloc(1, sizeof(struct trace_reader));
+    tr->in = in;
+    tr->state.next_pc = get_word(tr);
+    uint32_t mask = get_word(tr);
+    for (int i = 1; i < 32; i++)
+        if (mask & (1u << i))
+            tr->state.regs[i] = get_word(tr);
+    return tr;
+}
+
+int trace_read(struct trace_reader* tr, struct trace_record* rec)
+{
+    struct trace_state* s = &tr->state;
+    if (tr->done)
+        return 0;
+    int tag = get_byte(tr);
+    if (tag == EOF) {
+        tr->done = 1;
+        return 0;
+    }
+    memset(rec, 0, sizeof(*rec));
+    rec->rd = -1;
+    if (tag & TRACE_END) {
+        tr->done = 1;
+        rec->end = 1;
+        rec->reason = tag & 0x7f;
+        if (rec->reason == TRACE_UNHANDLED) {
+            rec->pc = get_varint(tr);
+            rec->insn = get_word(tr);
+        }
+        return 1;
+    }
+    uint32_t pc = s->next_pc;
+    if (tag & TRACE_JUMP)
+        pc += unzigzag(get_varint(tr));
+    struct insn_cache_entry* slot = insn_cache_slot(s, pc);
+    if (tag & TRACE_INSN) {
+        slot->pc = pc;
+        slot->insn = get_word(tr);
+    }
+    rec->pc = pc;
+    rec->insn = slot->insn;
+    // memory accesses are computed from the registers before the write
+    uint32_t opcode = rec->insn & 0x7f;
+    if (opcode == 0x03 || opcode == 0x23) {
+        rec->mem = opcode == 0x03 ? TRACE_LOAD : TRACE_STORE;
+        rec->mem_addr = mem_address(s, rec->insn);
+        rec->mem_size = mem_size(rec->insn);
+        if (opcode == 0x23)
+            rec->mem_data = store_data(s, rec->insn);
+    }
+    if (tag & TRACE_REG) {
+        rec->rd = get_byte(tr) & 31;
+        s->regs[rec->rd] += unzigzag(get_varint(tr));
+        rec->rd_value = s->regs[rec->rd];
+        if (rec->mem == TRACE_LOAD)
+            rec->mem_data = rec->rd_value;
+    }
+    s->regs[0] = 0;
+    s->next_pc = pc + 4;
+    return 1;
+}
+
+const uint32_t* trace_reader_regs(const struct trace_reader* tr)
+{
+    return tr->state.regs;
+}
+
+void trace_reader_close(struct trace_reader* tr)
+{
+    free(tr);
+}
@@ -0,0 +1,78 @@
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+#include <stdint.h>
+#include <stdio.h>
+
+// Compact binary execution trace.
+//
+// The file starts with the magic "RVT1", the start pc, a mask of the
+// registers which are non-zero at the start and their values (all 4 bytes,
+// little endian). Then follows one record per instruction. A record is a tag
+// byte whose bits say which fields follow, in this order:
+//   TRACE_JUMP   pc differs from previous pc + 4: zigzag varint pc delta
+//   TRACE_INSN   instruction word, 4 bytes. Left out when the word is
+//                already in a direct mapped table both ends keep of the
+//                last word seen at each pc
+//   TRACE_REG    register write: rd (1 byte), zigzag varint value delta
+// The reader keeps the register file up to date, so the address and data of
+// loads and stores follow from the registers and need no space in the trace.
+// A tag with TRACE_END set ends the trace; its low bits hold the reason.
+// For TRACE_UNHANDLED, the varint pc and the 4 byte instruction follow.
+
+#define TRACE_JUMP  0x01
+#define TRACE_INSN  0x02
+#define TRACE_REG   0x04
+#define TRACE_END   0x80
+
+#define TRACE_LOAD  1
+#define TRACE_STORE 2
+
+enum trace_end_reason {
+    TRACE_EXIT = 0,         // program terminated by an ecall
+    TRACE_UNHANDLED = 1,    // stopped at an unhandled instruction
+};
+
+struct trace_writer;
+
+struct trace_writer* trace_writer_create(FILE* out);
+
+// write the header: where execution starts and the registers at that point
+void trace_begin(struct trace_writer* tw, uint32_t start_pc, const uint32_t regs[32]);
+
+// record an executed instruction; regs holds the registers after it
+void trace_insn(struct trace_writer* tw, uint32_t pc, uint32_t insn, const uint32_t regs[32]);
+
+// record the end of the trace
+void trace_end(struct trace_writer* tw, enum trace_end_reason reason, uint32_t pc, uint32_t insn);
+
+// flush and delete the writer (the file is not closed)
+void trace_writer_close(struct trace_writer* tw);
+
+struct trace_record {
+    uint32_t pc;
+    uint32_t insn;
+    int rd;                 // destination register, -1 if none was written
+    uint32_t rd_value;
+    int mem;                // 0: no memory access, TRACE_LOAD or TRACE_STORE
+    uint32_t mem_addr;
+    int mem_size;           // 1, 2 or 4 bytes
+    uint32_t mem_data;      // stored data, or for loads the loaded value if rd was written
+    int end;                // set on the final record, then reason is valid
+    enum trace_end_reason reason;
+};
+
+struct trace_reader;
+
+// returns NULL if the file is not a trace
+struct trace_reader* trace_reader_open(FILE* in);
+
+// read the next record, returns 0 at the end of the file
+int trace_read(struct trace_reader* tr, struct trace_record* rec);
+
+// the registers after the last record read (at the start: from the header)
+const uint32_t* trace_reader_regs(const struct trace_reader* tr);
+
+void trace_reader_close(struct trace_reader* tr);
+
+#endif